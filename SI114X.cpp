@@ -29,7 +29,20 @@
 */
 
 #include "SI114X.h"
-#include "Wire.h"
+#if defined(ARDUINO_ARCH_AVR)
+#include <EEPROM.h>
+#endif
+#if !defined(ARDUINO)
+#include <stdio.h>
+#endif
+
+SI114X::SI114X(SiBus* Bus) {
+    this->Bus = Bus;
+    PartId = 0;
+    RevId = 0;
+    CalValid = false;
+    AutoCommand = 0;
+}
 /*  --------------------------------------------------------//
     default init
 
@@ -77,6 +90,7 @@ void SI114X::DeInit(void) {
     //
     WriteByte(SI114X_MEAS_RATE0, 0xFF);
     WriteByte(SI114X_COMMAND, SI114X_PSALS_AUTO);
+    AutoCommand = SI114X_PSALS_AUTO;
 }
 
 /*  --------------------------------------------------------//
@@ -85,13 +99,23 @@ void SI114X::DeInit(void) {
 
 */
 bool SI114X::Begin(void) {
-    Wire.begin();
+    Bus->begin();
     //
     //Init IIC  and reset si1145
     //
-    if (ReadByte(SI114X_PART_ID) != 0X45) {
+    return Begin(ReadByte(SI114X_PART_ID), ReadByte(SI114X_REV_ID));
+}
+/*  --------------------------------------------------------//
+    reset and init a si114x whose ids are already known,
+    e.g. from a probe of the bus; the bus must be begun
+
+*/
+bool SI114X::Begin(uint8_t PartId, uint8_t RevId) {
+    if (PartId < SI114X_PART_ID_SI1145 || PartId > SI114X_PART_ID_SI1147) {
         return false;
     }
+    this->PartId = PartId;
+    this->RevId = RevId;
     Reset();
     //
     //INIT
@@ -105,15 +129,19 @@ bool SI114X::Begin(void) {
 
 */
 void SI114X::Reset(void) {
-    WriteByte(SI114X_MEAS_RATE0, 0);
-    WriteByte(SI114X_MEAS_RATE1, 0);
-    WriteByte(SI114X_IRQ_ENABLE, 0);
-    WriteByte(SI114X_IRQ_MODE1, 0);
-    WriteByte(SI114X_IRQ_MODE2, 0);
-    WriteByte(SI114X_INT_CFG, 0);
-    WriteByte(SI114X_IRQ_STATUS, 0xFF);
-
-    WriteByte(SI114X_COMMAND, SI114X_RESET);
+    {
+        SiBusGuard Guard(Bus);
+        WriteByte(SI114X_MEAS_RATE0, 0);
+        WriteByte(SI114X_MEAS_RATE1, 0);
+        WriteByte(SI114X_IRQ_ENABLE, 0);
+        WriteByte(SI114X_IRQ_MODE1, 0);
+        WriteByte(SI114X_IRQ_MODE2, 0);
+        WriteByte(SI114X_INT_CFG, 0);
+        WriteByte(SI114X_IRQ_STATUS, 0xFF);
+
+        WriteByte(SI114X_COMMAND, SI114X_RESET);
+        AutoCommand = 0;
+    }
     delay(10);
     WriteByte(SI114X_HW_KEY, 0x17);
     delay(10);
@@ -123,41 +151,33 @@ void SI114X::Reset(void) {
 
 */
 void SI114X::WriteByte(uint8_t Reg, uint8_t Value) {
-    Wire.beginTransmission(SI114X_ADDR);
-    Wire.write(Reg);
-    Wire.write(Value);
-    Wire.endTransmission();
+    uint8_t Data[2] = {Reg, Value};
+    Bus->write(SI114X_ADDR, Data, 2);
 }
 /*  --------------------------------------------------------//
     read one byte data from si114x
 
 */
 uint8_t SI114X::ReadByte(uint8_t Reg) {
-    Wire.beginTransmission(SI114X_ADDR);
-    Wire.write(Reg);
-    Wire.endTransmission();
-    Wire.requestFrom(SI114X_ADDR, 1);
-    return Wire.read();
+    uint8_t Value = 0xFF;
+    Bus->read(SI114X_ADDR, Reg, &Value, 1);
+    return Value;
 }
 /*  --------------------------------------------------------//
     read half word(2 bytes) data from si114x
 
 */
 uint16_t SI114X::ReadHalfWord(uint8_t Reg) {
-    uint16_t Value;
-    Wire.beginTransmission(SI114X_ADDR);
-    Wire.write(Reg);
-    Wire.endTransmission();
-    Wire.requestFrom(SI114X_ADDR, 2);
-    Value = Wire.read();
-    Value |= (uint16_t)Wire.read() << 8;
-    return Value;
+    uint8_t Data[2] = {0xFF, 0xFF};
+    Bus->read(SI114X_ADDR, Reg, Data, 2);
+    return Data[0] | (uint16_t)Data[1] << 8;
 }
 /*  --------------------------------------------------------//
     read param data
 
 */
 uint8_t SI114X::ReadParamData(uint8_t Reg) {
+    SiBusGuard Guard(Bus);
     WriteByte(SI114X_COMMAND, Reg | SI114X_QUERY);
     return ReadByte(SI114X_RD);
 }
@@ -166,6 +186,7 @@ uint8_t SI114X::ReadParamData(uint8_t Reg) {
 
 */
 uint8_t SI114X::WriteParamData(uint8_t Reg, uint8_t Value) {
+    SiBusGuard Guard(Bus);
     //write Value into PARAMWR reg first
     WriteByte(SI114X_WR, Value);
     WriteByte(SI114X_COMMAND, Reg | SI114X_SET);
@@ -202,7 +223,215 @@ uint16_t SI114X::ReadProximity(uint8_t PSn) {
 uint16_t SI114X::ReadUV(void) {
     return (ReadHalfWord(SI114X_AUX_DATA0_UVINDEX0));
 }
+/*  --------------------------------------------------------//
+    send a command and wait for the response
+    returns the RESPONSE reg, 0 if the command timed out
 
+*/
+uint8_t SI114X::SendCommand(uint8_t Command) {
+    uint8_t Response;
+    {
+        SiBusGuard Guard(Bus);
+        //NOP clears RESPONSE so the next non-zero value belongs to Command
+        WriteByte(SI114X_COMMAND, SI114X_NOP);
+        WriteByte(SI114X_COMMAND, Command);
+    }
+    for (uint8_t i = 0; i < 25; i++) {
+        Response = ReadByte(SI114X_RESPONSE);
+        if (Response != 0) {
+            return Response;
+        }
+        delay(1);
+    }
+    return 0;
+}
+/*  --------------------------------------------------------//
+    fetch the factory calibration with GET_CAL
+    running measurements are paused while the block is read out
+    and resumed afterwards
+    fails before Begin(), when the chip is not identified yet
 
+*/
+bool SI114X::ReadCalibration(SI114X_Calibration* Cal) {
+    uint8_t Response;
+    if (PartId == 0) {
+        return false;
+    }
+    if (AutoCommand != 0) {
+        SendCommand(SI114X_PSALS_PAUSE);
+    }
+    //GET_CAL is only accepted while the sequencer is asleep
+    for (uint8_t i = 0; i < 25 && ReadByte(SI114X_CHIP_STAT) != SI114X_CHIP_STAT_SLEEP; i++) {
+        delay(1);
+    }
+    Response = SendCommand(SI114X_GET_CAL);
+    if (Response != 0 && !(Response & 0X80)) {
+        memset(Cal->Raw, 0xFF, SI114X_CAL_SIZE);
+        Bus->read(SI114X_ADDR, SI114X_ALS_VIS_DATA0, Cal->Raw, SI114X_CAL_SIZE);
+        Cal->PartId = PartId;
+        Cal->RevId = RevId;
+        SI114X_ParseCalibration(Cal);
+    }
+    if (AutoCommand != 0) {
+        SendCommand(AutoCommand);
+    }
+    //0x80 is INVALID_SETTING: the sequencer does not support GET_CAL
+    return Response != 0 && !(Response & 0X80);
+}
+/*  --------------------------------------------------------//
+    load the factory calibration from Store, fall back to GET_CAL
+    and save the result into Store
+    Store may be NULL to always query the chip
+    fails before Begin(), when there are no ids to key the store
+
+*/
+bool SI114X::LoadCalibration(SI114X_CalStore* Store) {
+    if (PartId == 0) {
+        return false;
+    }
+    if (Store != NULL && Store->Load(PartId, RevId, &Cal)) {
+        CalValid = true;
+        return true;
+    }
+    if (!ReadCalibration(&Cal)) {
+        return false;
+    }
+    CalValid = true;
+    if (Store != NULL) {
+        Store->Save(&Cal);
+    }
+    return true;
+}
+/*  --------------------------------------------------------//
+    the calibration loaded by LoadCalibration, NULL before that
 
+*/
+const SI114X_Calibration* SI114X::GetCalibration(void) {
+    return CalValid ? &Cal : NULL;
+}
 
+/*  --------------------------------------------------------//
+    unpack a 12-bit field spread over two bytes of the block
+    Align 0: MSB holds bits 11:4, the high nibble of LSB bits 3:0
+    Align 1: low nibble of MSB holds bits 11:8, LSB bits 7:0
+
+*/
+static uint16_t CollectCal(const uint8_t* Raw, uint8_t Msb, uint8_t Lsb, uint8_t Align) {
+    uint16_t Value;
+    if (Align == 0) {
+        Value = ((uint16_t)Raw[Msb] << 4) | (Raw[Lsb] >> 4);
+    } else {
+        Value = (((uint16_t)Raw[Msb] << 8) | Raw[Lsb]) & 0X0FFF;
+    }
+    //all zeros or all ones means the field was never programmed
+    if (Value == 0X0FFF) {
+        return 0;
+    }
+    return Value;
+}
+/*  --------------------------------------------------------//
+    fill the 12-bit fields of Cal from Cal->Raw
+    offsets are relative to ALS_VIS_DATA0
+
+*/
+void SI114X_ParseCalibration(SI114X_Calibration* Cal) {
+    Cal->SirpdAdchiIrled = CollectCal(Cal->Raw, 1, 0, 0);
+    Cal->SirpdAdcloIrled = CollectCal(Cal->Raw, 0, 3, 1);
+    Cal->SirpdAdcloWhled = CollectCal(Cal->Raw, 2, 4, 0);
+    Cal->VispdAdchiWhled = CollectCal(Cal->Raw, 4, 5, 1);
+    Cal->VispdAdcloWhled = CollectCal(Cal->Raw, 6, 7, 0);
+    Cal->LirpdAdchiIrled = CollectCal(Cal->Raw, 7, 8, 1);
+    Cal->LedDrv65 = CollectCal(Cal->Raw, 9, 9, 0);
+}
+
+/*  --------------------------------------------------------//
+    calibration record shared by the stores
+
+*/
+static uint8_t CalChecksum(const uint8_t* Record) {
+    uint8_t Sum = 0;
+    for (uint8_t i = 0; i < SI114X_CAL_RECORD_SIZE - 1; i++) {
+        Sum += Record[i];
+    }
+    return ~Sum;
+}
+
+static void PackCal(const SI114X_Calibration* Cal, uint8_t* Record) {
+    Record[0] = SI114X_CAL_MAGIC;
+    Record[1] = Cal->PartId;
+    Record[2] = Cal->RevId;
+    memcpy(Record + 3, Cal->Raw, SI114X_CAL_SIZE);
+    Record[SI114X_CAL_RECORD_SIZE - 1] = CalChecksum(Record);
+}
+
+static bool UnpackCal(const uint8_t* Record, uint8_t PartId, uint8_t RevId, SI114X_Calibration* Cal) {
+    if (Record[0] != SI114X_CAL_MAGIC || Record[1] != PartId || Record[2] != RevId ||
+            Record[SI114X_CAL_RECORD_SIZE - 1] != CalChecksum(Record)) {
+        return false;
+    }
+    Cal->PartId = PartId;
+    Cal->RevId = RevId;
+    memcpy(Cal->Raw, Record + 3, SI114X_CAL_SIZE);
+    SI114X_ParseCalibration(Cal);
+    return true;
+}
+
+#if defined(ARDUINO_ARCH_AVR)
+/*  --------------------------------------------------------//
+    EEPROM store
+
+*/
+SI114X_EEPROMCalStore::SI114X_EEPROMCalStore(int Address) {
+    this->Address = Address;
+}
+
+bool SI114X_EEPROMCalStore::Load(uint8_t PartId, uint8_t RevId, SI114X_Calibration* Cal) {
+    uint8_t Record[SI114X_CAL_RECORD_SIZE];
+    for (uint8_t i = 0; i < SI114X_CAL_RECORD_SIZE; i++) {
+        Record[i] = EEPROM.read(Address + i);
+    }
+    return UnpackCal(Record, PartId, RevId, Cal);
+}
+
+bool SI114X_EEPROMCalStore::Save(const SI114X_Calibration* Cal) {
+    uint8_t Record[SI114X_CAL_RECORD_SIZE];
+    PackCal(Cal, Record);
+    //update() skips cells that already hold the value
+    for (uint8_t i = 0; i < SI114X_CAL_RECORD_SIZE; i++) {
+        EEPROM.update(Address + i, Record[i]);
+    }
+    return true;
+}
+#endif
+
+#if !defined(ARDUINO)
+/*  --------------------------------------------------------//
+    file store
+
+*/
+SI114X_FileCalStore::SI114X_FileCalStore(const char* Path) {
+    this->Path = Path;
+}
+
+bool SI114X_FileCalStore::Load(uint8_t PartId, uint8_t RevId, SI114X_Calibration* Cal) {
+    uint8_t Record[SI114X_CAL_RECORD_SIZE];
+    FILE* File = fopen(Path, "rb");
+    if (File == NULL) {
+        return false;
+    }
+    size_t Len = fread(Record, 1, sizeof(Record), File);
+    fclose(File);
+    return Len == sizeof(Record) && UnpackCal(Record, PartId, RevId, Cal);
+}
+
+bool SI114X_FileCalStore::Save(const SI114X_Calibration* Cal) {
+    uint8_t Record[SI114X_CAL_RECORD_SIZE];
+    PackCal(Cal, Record);
+    FILE* File = fopen(Path, "wb");
+    if (File == NULL) {
+        return false;
+    }
+    size_t Len = fwrite(Record, 1, sizeof(Record), File);
+    return fclose(File) == 0 && Len == sizeof(Record);
+}
+#endif
@@ -1,6 +1,7 @@
 #ifndef _SI114X_H_
 #define _SI114X_H_
 #include "Arduino.h"
+#include "SiBus.h"
 /*  ------------------------------------------------------//
     Registers,Parameters and commands
 
@@ -160,11 +161,84 @@
 #define SI114X_IRQEN_PS3 0x10
 
 #define SI114X_ADDR 0X60
+//PART_ID of the parts this driver supports
+#define SI114X_PART_ID_SI1145 0X45
+#define SI114X_PART_ID_SI1146 0X46
+#define SI114X_PART_ID_SI1147 0X47
+//
+//GET_CAL
+//
+//GET_CAL leaves 12 bytes in ALS_VIS_DATA0..AUX_DATA1_UVINDEX1
+#define SI114X_CAL_SIZE 12
+//stored record: magic, part id, rev id, calibration block, checksum
+#define SI114X_CAL_MAGIC 0XCA
+#define SI114X_CAL_RECORD_SIZE (SI114X_CAL_SIZE + 4)
+//CHIP_STAT
+#define SI114X_CHIP_STAT_SLEEP 0X01
+
+/*  ------------------------------------------------------//
+    Factory calibration
+
+    Raw holds the block as returned by GET_CAL, the other fields
+    are the 12-bit values unpacked from it (0 when the field is blank).
+*/
+struct SI114X_Calibration {
+    uint8_t  PartId;
+    uint8_t  RevId;
+    uint8_t  Raw[SI114X_CAL_SIZE];
+    uint16_t SirpdAdchiIrled;
+    uint16_t SirpdAdcloIrled;
+    uint16_t SirpdAdcloWhled;
+    uint16_t VispdAdchiWhled;
+    uint16_t VispdAdcloWhled;
+    uint16_t LirpdAdchiIrled;
+    uint16_t LedDrv65;
+};
+
+void SI114X_ParseCalibration(SI114X_Calibration* Cal);
+
+/*  ------------------------------------------------------//
+    Non-volatile storage for the factory calibration
+
+    Load must only succeed for a record saved with the same part and
+    revision id.
+*/
+class SI114X_CalStore {
+  public:
+    virtual bool Load(uint8_t PartId, uint8_t RevId, SI114X_Calibration* Cal) = 0;
+    virtual bool Save(const SI114X_Calibration* Cal) = 0;
+};
+
+#if defined(ARDUINO_ARCH_AVR)
+//keeps the record in SI114X_CAL_RECORD_SIZE bytes of EEPROM starting at Address
+class SI114X_EEPROMCalStore : public SI114X_CalStore {
+  public:
+    SI114X_EEPROMCalStore(int Address = 0);
+    bool Load(uint8_t PartId, uint8_t RevId, SI114X_Calibration* Cal);
+    bool Save(const SI114X_Calibration* Cal);
+  private:
+    int Address;
+};
+#endif
+
+#if !defined(ARDUINO)
+//keeps the record in a file on the host
+class SI114X_FileCalStore : public SI114X_CalStore {
+  public:
+    SI114X_FileCalStore(const char* Path);
+    bool Load(uint8_t PartId, uint8_t RevId, SI114X_Calibration* Cal);
+    bool Save(const SI114X_Calibration* Cal);
+  private:
+    const char* Path;
+};
+#endif
 
 
 class SI114X {
   public:
+    SI114X(SiBus* Bus = &SiDefaultBus);
     bool Begin(void);
+    bool Begin(uint8_t PartId, uint8_t RevId);
     void Reset(void);
     void DeInit(void);
     uint8_t  ReadParamData(uint8_t Reg);
@@ -173,10 +247,21 @@ class SI114X {
     uint16_t ReadIR(void);
     uint16_t ReadProximity(uint8_t PSn);
     uint16_t ReadUV(void);
+    bool LoadCalibration(SI114X_CalStore* Store);
+    bool ReadCalibration(SI114X_Calibration* Cal);
+    const SI114X_Calibration* GetCalibration(void);
   private:
     void  WriteByte(uint8_t Reg, uint8_t Value);
     uint8_t  ReadByte(uint8_t Reg);
     uint16_t ReadHalfWord(uint8_t Reg);
+    uint8_t  SendCommand(uint8_t Command);
+    SiBus* Bus;
+    uint8_t  PartId;
+    uint8_t  RevId;
+    bool CalValid;
+    //the *_AUTO command running, 0 while measurements are stopped
+    uint8_t AutoCommand;
+    SI114X_Calibration Cal;
 };
 
 
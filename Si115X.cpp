@@ -1,8 +1,18 @@
 #include <Arduino.h>
 #include "Si115X.h"
 
-Si115X::Si115X(uint8_t addr) {
+Si115X::Si115X(uint8_t addr, SiBus *bus) {
     device_address = addr;
+    this->bus = bus;
+    is_autonomous = false;
+    chan_list = 0;
+    pending_irq = 0;
+    capture_channel = 0xFF;
+    wide_channels = 0;
+    for(uint8_t i = 0; i < 6; i++){
+        host_samples[i] = 1;
+        sw_gains[i] = 0;
+    }
 }
 
 /**
@@ -38,6 +48,10 @@ void Si115X::config_channel(uint8_t index, const uint8_t *conf){
     // - bits[2] - Threshold polarity
     // - bits[1:0] - Threshold enable
     param_set(Si115X::ADCPOST_0 + inc, conf[2]);
+    if(conf[2] & 0x40)
+      wide_channels |= 1 << index;
+    else
+      wide_channels &= ~(1 << index);
 
     // MEASCONFIGx:
     // - bits[7:6] - MEASCOUNTx select
@@ -51,39 +65,48 @@ void Si115X::config_channel(uint8_t index, const uint8_t *conf){
  * Writes data over i2c
  */
 void Si115X::write_data(uint8_t addr, const uint8_t *data, size_t len){
-    Wire.beginTransmission(addr);
-    Wire.write(data, len);
-    Wire.endTransmission();
+    bus->write(addr, data, len);
 }
 
 /**
  * Reads data from a register over i2c
  */
 int Si115X::read_register(uint8_t addr, uint8_t reg, int bytesOfData){
-    int val = -1;
-  
-    Si115X::write_data(addr, &reg, sizeof(reg));
-    Wire.requestFrom(addr, (uint8_t)bytesOfData);
-  
-    if(Wire.available())
-      val = Wire.read();
-	
+    uint8_t val;
+
+    // only the first byte is returned, so only one is read
+    if(bytesOfData < 1 || bus->read(addr, reg, &val, 1) != 1)
+      return -1;
+
     return val;
 }
 
+/**
+ * Reads len consecutive registers starting at reg, returns the number of bytes read
+ */
+size_t Si115X::read_block(uint8_t addr, uint8_t reg, uint8_t *data, size_t len){
+    return bus->read(addr, reg, data, len);
+}
+
 /**
  * param set as shown in the datasheet
  */
 void Si115X::param_set(uint8_t loc, uint8_t val){
-    const auto preResponse0 = read_register(device_address, RESPONSE_0);
+    int preResponse0;
 
-    uint8_t packet[2];
-    packet[0] = HOSTIN_0;
-    packet[1] = val;
-    write_data(device_address, packet, sizeof(packet));
-    packet[0] = COMMAND;
-    packet[1] = loc | PARAM_SET;
-    write_data(device_address, packet, sizeof(packet));
+    {
+        // the poll below only needs the bus per read
+        SiBusGuard guard(bus);
+        preResponse0 = read_register(device_address, RESPONSE_0);
+
+        uint8_t packet[2];
+        packet[0] = HOSTIN_0;
+        packet[1] = val;
+        write_data(device_address, packet, sizeof(packet));
+        packet[0] = COMMAND;
+        packet[1] = loc | PARAM_SET;
+        write_data(device_address, packet, sizeof(packet));
+    }
 
     while ((read_register(device_address, RESPONSE_0) & 0x0f) != ((preResponse0 + 1) & 0x0f))
     {
@@ -95,12 +118,17 @@ void Si115X::param_set(uint8_t loc, uint8_t val){
  * param query as shown in the datasheet
  */
 int Si115X::param_query(uint8_t loc){
-    const auto preResponse0 = read_register(device_address, RESPONSE_0);
+    int preResponse0;
 
-    uint8_t packet[2];
-    packet[0] = COMMAND;
-    packet[1] = loc | PARAM_QUERY;
-    write_data(device_address, packet, sizeof(packet));
+    {
+        SiBusGuard guard(bus);
+        preResponse0 = read_register(device_address, RESPONSE_0);
+
+        uint8_t packet[2];
+        packet[0] = COMMAND;
+        packet[1] = loc | PARAM_QUERY;
+        write_data(device_address, packet, sizeof(packet));
+    }
 
     while ((read_register(device_address, RESPONSE_0) & 0x0f) != ((preResponse0 + 1) & 0x0f))
     {
@@ -114,12 +142,17 @@ int Si115X::param_query(uint8_t loc){
  * Sends command to the command register
  */
 uint8_t Si115X::send_command(uint8_t code){
-    const auto preResponse0 = read_register(device_address, RESPONSE_0);
-
+    int preResponse0;
     uint8_t packet[2];
-    packet[0] = COMMAND;
-    packet[1] = code;
-    write_data(device_address, packet, sizeof(packet));
+
+    {
+        SiBusGuard guard(bus);
+        preResponse0 = read_register(device_address, RESPONSE_0);
+
+        packet[0] = COMMAND;
+        packet[1] = code;
+        write_data(device_address, packet, sizeof(packet));
+    }
 
     while (true)
     {
@@ -161,14 +194,35 @@ int Si115X::get_int_from_bytes(const uint8_t *data, size_t len){
 
 
 bool Si115X::Begin(bool mode){
-    is_autonomous = mode;
-    Wire.begin();
+    bus->begin();
     // Wire.setClock(400000);
     // send_command(RESET_SW);
-    if (ReadByte(0x00) != 0x51) {
+    return Begin(mode, ReadByte(PART_ID));
+}
+
+/**
+ * Starts a device whose PART_ID is already known, e.g. from a probe of
+ * the bus, without reading it again. The bus must be begun.
+ */
+bool Si115X::Begin(bool mode, uint8_t part_id){
+    if (part_id != PART_ID_SI1151) {
         return false;
     }
 
+    return start(mode);
+}
+
+/**
+ * Resets and configures a device already identified as an Si1151
+ */
+bool Si115X::start(bool mode){
+    is_autonomous = mode;
+    wide_channels = 0;
+    for(uint8_t i = 0; i < 6; i++){
+        host_samples[i] = 1;
+        sw_gains[i] = 0;
+    }
+
     // Reset
     uint8_t packet[2];
     packet[0] = COMMAND;
@@ -182,7 +236,8 @@ bool Si115X::Begin(bool mode){
     }
 
     // Enable 2 channels for proximity measurement
-    param_set(CHAN_LIST, 0B000011);
+    chan_list = 0B000011;
+    param_set(CHAN_LIST, chan_list);
     // Enable Interrupt
     write_register(device_address, IRQ_ENABLE, 0B000011);
     // Initialize LED current
@@ -199,12 +254,12 @@ bool Si115X::Begin(bool mode){
         param_set(THRESHOLD0_H, 0);
         uint8_t conf[4]; // ADCCONFIGx, ADCSENSx, ADCPOSTx, MEASCONFIGx
         conf[0] = 0B01100000; // 1x Small IR
-        conf[1] = 0B00000010; // 48.8us Nominal Measurement time for 512 decimation rate
+        conf[1] = 0B00000010; // 97.6us Nominal Measurement time for 512 decimation rate
         conf[2] = 0B00000001; // 16-bits output, Interrupt when the measurement is larger than THRESHOLD0
         conf[3] = 0B01000001; // enable LED1A, the time between measurements is 800*MEASRATE*MEASCOUNT0 us
         config_channel(0, conf);
         conf[0] = 0B01101011; // 1x Visible
-        conf[1] = 0B00000010; // 48.8us Nominal Measurement time for 512 decimation rate
+        conf[1] = 0B00000010; // 97.6us Nominal Measurement time for 512 decimation rate
         conf[2] = 0B00000001; // 16-bits output, Interrupt when the measurement is larger than THRESHOLD0
         conf[3] = 0B10001001; // enable LED1B, the time between measurements is 800*MEASRATE*MEASCOUNT1 us
         config_channel(1, conf);
@@ -227,24 +282,560 @@ bool Si115X::Begin(bool mode){
 
 uint16_t Si115X::ReadIR(void) {
     if (!is_autonomous) send_command(FORCE);
-    uint8_t data[2];
-    data[0] = read_register(device_address, HOSTOUT_0);
-    data[1] = read_register(device_address, HOSTOUT_1);
-    return (data[0] << 8) + data[1];
+    return read_channel(0);
 }
 
 uint16_t Si115X::ReadVisible(void) {
     if (!is_autonomous) send_command(FORCE);
-    uint8_t data[2];
-    data[0] = read_register(device_address, HOSTOUT_2);
-    data[1] = read_register(device_address, HOSTOUT_3);
-    return (data[0] << 8) + data[1];
+    return read_channel(1);
 }
 
 uint8_t Si115X::ReadByte(uint8_t Reg) {
-    Wire.beginTransmission(device_address);
-    Wire.write(Reg);
-    Wire.endTransmission();
-    Wire.requestFrom(device_address, (uint8_t)1);
-    return Wire.read();
+    uint8_t val = 0xFF;
+    bus->read(device_address, Reg, &val, 1);
+    return val;
+}
+
+/**
+ * Relative error of a measurement period in 1/1024 units, saturating at 1024.
+ * Sampling slower than requested loses data, so it counts twice.
+ */
+static uint32_t period_error(uint32_t achieved, uint32_t target){
+    uint32_t diff = achieved > target ? achieved - target : target - achieved;
+    uint32_t error;
+
+    if(diff >= target){
+        error = 1024;
+    }
+    else {
+        // keep diff * 1024 within 32 bits
+        while(target > 0x3FFFFFUL){
+            target >>= 1;
+            diff >>= 1;
+        }
+        error = (diff << 10) / target;
+    }
+    return achieved > target ? error * 2 : error;
+}
+
+/**
+ * Ratio hi / lo in 1/1024 units
+ */
+static uint32_t period_ratio(uint32_t hi, uint32_t lo){
+    // keep hi * 1024 within 32 bits
+    while(hi > 0x3FFFFFUL){
+        hi >>= 1;
+        lo >>= 1;
+    }
+    return (hi << 10) / (lo ? lo : 1);
+}
+
+/**
+ * Period in us of a number of MEASRATE ticks, saturating at 32 bits
+ */
+static uint32_t ticks_to_us(uint32_t ticks){
+    return ticks > 0xFFFFFFFFUL / Si115X::MEASRATE_TICK_US ? 0xFFFFFFFFUL : ticks * Si115X::MEASRATE_TICK_US;
+}
+
+/**
+ * Picks the MEASCOUNT for one bank at a given MEASRATE: the whole count
+ * just below or just above the bank's period, whichever gives the bank's
+ * channels the smaller total error. Returns that error.
+ */
+static uint32_t bank_count(const Si115X::ChannelRate *rates, uint8_t count, uint8_t bank, uint32_t target,
+                           uint32_t rate, uint8_t *meascount){
+    uint32_t q = target / ticks_to_us(rate);
+    uint32_t best_error = 0xFFFFFFFFUL;
+
+    for(uint32_t n = q; n <= q + 1; n++){
+        uint32_t c = n < 1 ? 1 : (n > 255 ? 255 : n);
+        uint32_t error = 0;
+        for(uint8_t i = 0; i < count; i++){
+            if(rates[i].bank == bank)
+              error += period_error(ticks_to_us(rate * c), rates[i].period_us);
+        }
+        if(error < best_error){
+            best_error = error;
+            *meascount = c;
+        }
+    }
+    return best_error;
+}
+
+/**
+ * Picks MEASRATE and the three MEASCOUNT values closest to the requested
+ * periods. Channels are grouped into at most three banks (merging the
+ * closest periods towards the faster one), then the MEASRATEs that give
+ * the fastest bank a whole count, from either side, are tried and the one
+ * with the smallest total relative error against the requested periods
+ * wins, preferring the larger MEASRATE on ties. When the periods span
+ * more than MEASCOUNT can cover, the slow channels are the ones that end
+ * up sampled faster than requested.
+ * Fills in achieved_us and bank for every entry of rates. Each channel
+ * may appear only once.
+ */
+bool Si115X::solve_schedule(ChannelRate *rates, uint8_t count, Schedule *schedule){
+    uint32_t banks[6];
+    uint8_t nbanks = 0;
+    uint8_t seen = 0;
+
+    if(count == 0 || count > 6)
+      return false;
+
+    for(uint8_t i = 0; i < count; i++){
+        uint32_t t = rates[i].period_us;
+        if(rates[i].channel > 5 || t == 0 || (seen & (1 << rates[i].channel)))
+          return false;
+        seen |= 1 << rates[i].channel;
+
+        // insert into the sorted list of distinct periods
+        uint8_t j = 0;
+        while(j < nbanks && banks[j] < t)
+          j++;
+        if(j < nbanks && banks[j] == t)
+          continue;
+        for(uint8_t k = nbanks; k > j; k--)
+          banks[k] = banks[k - 1];
+        banks[j] = t;
+        nbanks++;
+    }
+
+    // merge neighbours with the smallest ratio until three banks are left
+    while(nbanks > 3){
+        uint8_t best = 0;
+        uint32_t best_ratio = 0xFFFFFFFFUL;
+        for(uint8_t j = 0; j + 1 < nbanks; j++){
+            uint32_t ratio = period_ratio(banks[j + 1], banks[j]);
+            if(ratio < best_ratio){
+                best_ratio = ratio;
+                best = j;
+            }
+        }
+        for(uint8_t k = best + 1; k + 1 < nbanks; k++)
+          banks[k] = banks[k + 1];
+        nbanks--;
+    }
+
+    // each channel goes to the bank closest to its own period
+    for(uint8_t i = 0; i < count; i++){
+        uint8_t best = 0;
+        for(uint8_t j = 1; j < nbanks; j++){
+            if(period_error(banks[j], rates[i].period_us) < period_error(banks[best], rates[i].period_us))
+              best = j;
+        }
+        rates[i].bank = best;
+    }
+
+    // MEASCOUNT is 8 bits, so the slowest bank is only reached from min_rate up
+    uint32_t min_rate = (banks[nbanks - 1] / MEASRATE_TICK_US + 254) / 255;
+    uint32_t best_rate = 0;
+    uint32_t best_error = 0xFFFFFFFFUL;
+    uint8_t best_counts[3] = {1, 1, 1};
+
+    for(uint16_t c = 0; c <= 255; c++){
+        // c == 0 tries min_rate itself, then MEASRATE just below and above fastest / c
+        uint32_t q = c == 0 ? min_rate : banks[0] / ((uint32_t)MEASRATE_TICK_US * c);
+        for(uint32_t rate = q; rate <= q + (c == 0 ? 0 : 1); rate++){
+            if(rate < 1 || rate > 65535)
+              continue;
+
+            uint32_t error = 0;
+            uint8_t counts[3] = {1, 1, 1};
+            for(uint8_t j = 0; j < nbanks; j++)
+              error += bank_count(rates, count, j, banks[j], rate, &counts[j]);
+            if(error < best_error || (error == best_error && rate > best_rate)){
+                best_error = error;
+                best_rate = rate;
+                for(uint8_t j = 0; j < 3; j++)
+                  best_counts[j] = counts[j];
+            }
+        }
+    }
+    if(best_rate == 0)
+      return false;
+
+    schedule->measrate = best_rate;
+    for(uint8_t j = 0; j < 3; j++)
+      schedule->meascount[j] = best_counts[j];
+    for(uint8_t i = 0; i < count; i++)
+      rates[i].achieved_us = ticks_to_us((uint32_t)schedule->measrate * schedule->meascount[rates[i].bank]);
+
+    return true;
+}
+
+/**
+ * Runs each channel of rates autonomously at its own rate. The scheduled
+ * channels replace CHAN_LIST and raise an interrupt on every measurement,
+ * so read_fresh_channels() tells which of them have new data.
+ */
+bool Si115X::schedule_channels(ChannelRate *rates, uint8_t count){
+    Schedule schedule;
+
+    if(!solve_schedule(rates, count, &schedule))
+      return false;
+
+    if(is_autonomous)
+      send_command(PAUSE);
+
+    param_set(MEASRATE_H, schedule.measrate >> 8);
+    param_set(MEASRATE_L, schedule.measrate & 0xFF);
+    param_set(MEASCOUNT_0, schedule.meascount[0]);
+    param_set(MEASCOUNT_1, schedule.meascount[1]);
+    param_set(MEASCOUNT_2, schedule.meascount[2]);
+
+    uint8_t mask = 0;
+    for(uint8_t i = 0; i < count; i++){
+        // MEASCONFIGx bits[7:6]: 01, 10, 11 select MEASCOUNT_0, _1, _2
+        uint8_t loc = MEASCONFIG_0 + rates[i].channel * 4;
+        uint8_t conf = param_query(loc);
+        param_set(loc, (conf & 0x3F) | ((rates[i].bank + 1) << 6));
+        // ADCPOSTx bits[1:0] clear: interrupt on every measurement, not on thresholds
+        loc = ADCPOST_0 + rates[i].channel * 4;
+        conf = param_query(loc);
+        param_set(loc, conf & 0xFC);
+        mask |= 1 << rates[i].channel;
+    }
+
+    chan_list = mask;
+    pending_irq = 0;
+    param_set(CHAN_LIST, chan_list);
+    write_register(device_address, IRQ_ENABLE, chan_list);
+
+    is_autonomous = true;
+    send_command(START);
+
+    return true;
+}
+
+/**
+ * Returns a bit mask of the channels measured since the last call.
+ * Reading IRQ_STATUS clears it, so bits that read_averaged() saw but did
+ * not consume are kept in pending_irq and returned here.
+ */
+uint8_t Si115X::read_fresh_channels(void){
+    int status = read_register(device_address, IRQ_STATUS);
+    uint8_t fresh = pending_irq;
+
+    pending_irq = 0;
+    if(status >= 0)
+      fresh |= status;
+    return fresh & chan_list;
+}
+
+/**
+ * Autonomous measurement period of a channel in us, from its MEASCONFIGx
+ * counter select, MEASRATE and that MEASCOUNT. Returns 0 if the channel
+ * is not measured autonomously.
+ */
+uint32_t Si115X::channel_period_us(uint8_t index){
+    int conf = param_query(MEASCONFIG_0 + index * 4);
+    int rate_h = param_query(MEASRATE_H);
+    int rate_l = param_query(MEASRATE_L);
+
+    if(conf < 0 || rate_h < 0 || rate_l < 0 || (conf >> 6) == 0)
+      return 0;
+
+    int count = param_query(MEASCOUNT_0 + (conf >> 6) - 1);
+    if(count <= 0)
+      return 0;
+    return ticks_to_us((uint32_t)((rate_h << 8) | rate_l) * count);
+}
+
+/**
+ * Reads the last result of a channel from its HOSTOUT slot, 2 bytes or
+ * 3 for a channel with 24-bit output. 24-bit results are signed. Returns
+ * false for a channel that is not in CHAN_LIST, which has no slot.
+ */
+bool Si115X::read_result(uint8_t index, int32_t *value){
+    uint8_t offset = 0;
+
+    if(index > 5 || !(chan_list & (1 << index)))
+      return false;
+
+    for(uint8_t i = 0; i < index; i++){
+        if(chan_list & (1 << i))
+          offset += wide_channels & (1 << i) ? 3 : 2;
+    }
+
+    uint8_t data[3];
+    uint8_t len = wide_channels & (1 << index) ? 3 : 2;
+    if(read_block(device_address, HOSTOUT_0 + offset, data, len) != len)
+      return false;
+    if(len == 3)
+      *value = ((int32_t)(int8_t)data[0] << 16) | ((uint16_t)data[1] << 8) | data[2];
+    else
+      *value = ((uint16_t)data[0] << 8) | data[1];
+    return true;
+}
+
+/**
+ * Reads the last result of a channel. A 24-bit result, as set up by
+ * set_noise_target(), is clamped to 16 bits; read_averaged() keeps it
+ * whole. Returns 0xFFFF for a channel that is not in CHAN_LIST.
+ */
+uint16_t Si115X::read_channel(uint8_t index){
+    int32_t value;
+
+    if(!read_result(index, &value))
+      return 0xFFFF;
+    return value < 0 ? 0 : value > 0xFFFF ? 0xFFFF : value;
+}
+
+/**
+ * Switches to high-rate capture of a single channel: only that channel is
+ * measured, autonomously at the minimum period of one MEASRATE tick.
+ * The previous configuration is restored by end_capture().
+ */
+bool Si115X::begin_capture(uint8_t index){
+    if(index > 5 || capture_channel != 0xFF)
+      return false;
+
+    uint8_t meas_config = MEASCONFIG_0 + index * 4;
+
+    capture_saved[0] = chan_list;
+    capture_saved[1] = param_query(MEASRATE_H);
+    capture_saved[2] = param_query(MEASRATE_L);
+    capture_saved[3] = param_query(MEASCOUNT_0);
+    capture_saved[4] = param_query(meas_config);
+    capture_saved[5] = param_query(ADCPOST_0 + index * 4);
+    capture_autonomous = is_autonomous;
+    capture_channel = index;
+
+    if(is_autonomous)
+      send_command(PAUSE);
+
+    chan_list = 1 << index;
+    param_set(CHAN_LIST, chan_list);
+    param_set(MEASRATE_H, 0);
+    param_set(MEASRATE_L, 1);
+    param_set(MEASCOUNT_0, 1);
+    param_set(meas_config, (capture_saved[4] & 0x3F) | 0x40);
+    // 16-bit output for capture_burst(), no threshold: interrupt on every measurement
+    param_set(ADCPOST_0 + index * 4, capture_saved[5] & 0xBC);
+    wide_channels &= ~(1 << index);
+    write_register(device_address, IRQ_ENABLE, chan_list);
+
+    is_autonomous = true;
+    send_command(START);
+
+    return true;
+}
+
+/**
+ * Fills samples with count evenly spaced results of the capture channel.
+ * IRQ_STATUS and the result are fetched in one 3-byte read; each result is
+ * placed by its arrival time, and slots missed between two polls are
+ * interpolated. Keeping up needs a 400 kHz bus. Stores the mean spacing
+ * measured by micros() in period_us and the longest run of interpolated
+ * slots in longest_gap if given. A gap of more than a slot or two can
+ * hide whole flicker cycles, so such a burst should not be analyzed.
+ * Returns the number of samples filled, which is short of count only on
+ * timeout.
+ */
+uint16_t Si115X::capture_burst(uint16_t *samples, uint16_t count, uint16_t *period_us,
+                               uint16_t *longest_gap){
+    const uint32_t period = MEASRATE_TICK_US;
+    const uint32_t timeout = period * count * 2 + 100000UL;
+    uint8_t data[3];
+    uint16_t filled = 0;
+    uint16_t longest = 0;
+    uint16_t last = 0;
+    uint32_t first_time = 0;
+    // arrival time and slot of the last result read, stored or not
+    uint32_t last_time = 0;
+    uint32_t last_slot = 0;
+    uint32_t start = micros();
+
+    if(capture_channel == 0xFF || count == 0)
+      return 0;
+
+    // drop a result that may be older than this burst
+    read_register(device_address, IRQ_STATUS);
+
+    while(filled < count && micros() - start < timeout){
+        // IRQ_STATUS, HOSTOUT_0 and HOSTOUT_1 are consecutive
+        if(read_block(device_address, IRQ_STATUS, data, sizeof(data)) != sizeof(data))
+          continue;
+        if(!(data[0] & chan_list))
+          continue;
+
+        uint32_t now = micros();
+        uint16_t sample = (data[1] << 8) + data[2];
+
+        if(filled == 0){
+            first_time = now;
+            samples[filled++] = sample;
+        }
+        else {
+            uint32_t slot = (now - first_time + period / 2) / period;
+            if(slot < filled)
+              slot = filled;
+            // linear interpolation over the slots missed since the last result
+            uint32_t gap = slot - filled + 1;
+            uint32_t missed = 0;
+            for(uint32_t k = 1; k < gap && filled < count; k++){
+                samples[filled++] = last + ((int32_t)sample - last) * (int32_t)k / (int32_t)gap;
+                missed++;
+            }
+            if(missed > longest)
+              longest = missed;
+            last_time = now;
+            last_slot = slot;
+            if(filled == count)
+              break;
+            samples[filled++] = sample;
+        }
+        last = sample;
+    }
+
+    if(period_us != NULL)
+      *period_us = last_slot > 0 ? (last_time - first_time + last_slot / 2) / last_slot : period;
+    if(longest_gap != NULL)
+      *longest_gap = longest;
+
+    return filled;
+}
+
+/**
+ * Leaves high-rate capture and restores the configuration saved by begin_capture()
+ */
+void Si115X::end_capture(void){
+    if(capture_channel == 0xFF)
+      return;
+
+    send_command(PAUSE);
+
+    param_set(ADCPOST_0 + capture_channel * 4, capture_saved[5]);
+    if(capture_saved[5] & 0x40)
+      wide_channels |= 1 << capture_channel;
+    param_set(MEASCONFIG_0 + capture_channel * 4, capture_saved[4]);
+    param_set(MEASCOUNT_0, capture_saved[3]);
+    param_set(MEASRATE_L, capture_saved[2]);
+    param_set(MEASRATE_H, capture_saved[1]);
+    chan_list = capture_saved[0];
+    param_set(CHAN_LIST, chan_list);
+    write_register(device_address, IRQ_ENABLE, chan_list);
+
+    is_autonomous = capture_autonomous;
+    capture_channel = 0xFF;
+
+    if(is_autonomous)
+      send_command(START);
+}
+
+/**
+ * Averages a channel to cut its noise by noise_divisor. That takes
+ * noise_divisor^2 measurements, which are summed on chip first (ADCSENSx
+ * SW_GAIN, up to 2^MAX_SW_GAIN) into a 24-bit result with no post shift,
+ * so one FORCE and one read still give one result and the sum keeps its
+ * low bits. Only the remainder is averaged on the host by read_averaged(),
+ * which returns the mean with AVERAGE_FRACTION_BITS below one
+ * measurement. One extra bit of effective resolution takes doubling
+ * noise_divisor, down to 1/128 of a measurement step at 2^MAX_SW_GAIN.
+ * Decimation and HW_GAIN set the channel's sensitivity and are left as
+ * configured; they only enter the reported conversion time. Returns false
+ * if the target would take more than 255 host samples.
+ */
+bool Si115X::set_noise_target(uint8_t index, uint8_t noise_divisor, Averaging *plan){
+    if(index > 5 || noise_divisor == 0)
+      return false;
+
+    uint32_t samples = (uint32_t)noise_divisor * noise_divisor;
+    uint8_t sw_gain = 0;
+    while(sw_gain < MAX_SW_GAIN && (2UL << sw_gain) <= samples)
+      sw_gain++;
+    uint32_t host = (samples + (1UL << sw_gain) - 1) >> sw_gain;
+    // past 2^MAX_SW_GAIN * 255 measurements, i.e. noise_divisor above 180
+    if(host > 255)
+      return false;
+
+    uint8_t inc = index * 4;
+    int config = param_query(ADCCONFIG_0 + inc);
+    int sens = param_query(ADCSENS_0 + inc);
+    int post = param_query(ADCPOST_0 + inc);
+    if(config < 0 || sens < 0 || post < 0)
+      return false;
+
+    if(is_autonomous)
+      send_command(PAUSE);
+
+    // ADCSENSx bits[6:4] SW_GAIN; ADCPOSTx bit[6] 24-bit output, bits[5:3] POSTSHIFT 0.
+    // 2^MAX_SW_GAIN 16-bit measurements still fit a signed 24-bit result.
+    param_set(ADCSENS_0 + inc, (sens & 0x8F) | (sw_gain << 4));
+    param_set(ADCPOST_0 + inc, (post & 0x87) | 0x40);
+    wide_channels |= 1 << index;
+
+    if(is_autonomous)
+      send_command(START);
+
+    plan->sw_gain = sw_gain;
+    plan->host_samples = host;
+    host_samples[index] = host;
+    sw_gains[index] = sw_gain;
+
+    // ADCSENSx HW_GAIN is the measurement time at a decimation rate of 512:
+    // 24.4 us (25000 / 1024 us) at HW_GAIN 0, doubling per HW_GAIN step.
+    // ADCCONFIGx DECIM_RATE doubles it again per step above 512.
+    int8_t decim_steps[4] = {1, 2, 3, 0};   // 1024, 2048, 4096, 512
+    int8_t e = (sens & 0x0F) + sw_gain + decim_steps[(config >> 5) & 0x03];
+    plan->conversion_us = e >= 10 ? 25000UL << (e - 10) : (25000UL << e) >> 10;
+    plan->total_us = plan->conversion_us > 0xFFFFFFFFUL / plan->host_samples ?
+                     0xFFFFFFFFUL : plan->conversion_us * plan->host_samples;
+
+    return true;
+}
+
+/**
+ * Reads a channel averaged over the host samples set by set_noise_target(),
+ * in 1/2^AVERAGE_FRACTION_BITS of one measurement. In autonomous mode it
+ * waits for each new result through IRQ_STATUS, which needs the channel's
+ * interrupt enabled; other channels' bits are left for
+ * read_fresh_channels(). Returns 0xFFFFFFFF for a channel not in
+ * CHAN_LIST or if a result does not arrive within two measurement periods.
+ */
+uint32_t Si115X::read_averaged(uint8_t index){
+    if(index > 5 || !(chan_list & (1 << index)))
+      return 0xFFFFFFFFUL;
+
+    uint8_t n = host_samples[index];
+    uint8_t bit = 1 << index;
+    uint32_t timeout = 0;
+    uint32_t sum = 0;
+
+    if(is_autonomous && n > 1){
+        uint32_t period = channel_period_us(index);
+        if(period == 0)
+          return 0xFFFFFFFFUL;
+        timeout = period > (0xFFFFFFFFUL - 100000UL) / 2 ? 0xFFFFFFFFUL : period * 2 + 100000UL;
+    }
+
+    for(uint8_t i = 0; i < n; i++){
+        if(!is_autonomous){
+            send_command(FORCE);
+        }
+        else if(n > 1){
+            uint32_t start = micros();
+            uint8_t fresh;
+            while(!((fresh = read_fresh_channels()) & bit)){
+                pending_irq |= fresh;
+                if(micros() - start >= timeout)
+                  return 0xFFFFFFFFUL;
+                yield();
+            }
+            pending_irq |= fresh & ~bit;
+        }
+        int32_t result;
+        if(!read_result(index, &result))
+          return 0xFFFFFFFFUL;
+        // dark offset subtraction can leave a result just below zero
+        if(result > 0)
+          sum += result;
+    }
+
+    // sum / (n * 2^sw_gain), keeping the fraction bits; each result is
+    // below 2^23 and n below 2^8, so neither step overflows
+    uint8_t shift = AVERAGE_FRACTION_BITS - sw_gains[index];
+    uint32_t whole = sum / n;
+    uint32_t rest = sum % n;
+    return (whole << shift) + ((rest << shift) + n / 2) / n;
 }
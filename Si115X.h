@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include "SiBus.h"
 
 class Si115X
 {
@@ -121,11 +122,42 @@ class Si115X
 			LOWER_THRESHOLD_H = 0x2C,
 			LOWER_THRESHOLD_L = 0x2D
 		} ParameterAddress;
+
+		static const uint8_t PART_ID_SI1151 = 0x51;
+
+		// Autonomous measurements are spaced MEASRATE * MEASCOUNTx ticks apart
+		static const uint16_t MEASRATE_TICK_US = 800;
+
+		typedef struct {
+			uint8_t channel;      // channel index, 0 to 5
+			uint32_t period_us;   // requested time between measurements
+			uint32_t achieved_us; // set by the solver
+			uint8_t bank;         // MEASCOUNT_x used, set by the solver
+		} ChannelRate;
+
+		typedef struct {
+			uint16_t measrate;
+			uint8_t meascount[3];
+		} Schedule;
+
+		// Results accumulated on chip are limited by ADCSENSx bits[6:4]
+		static const uint8_t MAX_SW_GAIN = 7;
+		// read_averaged() returns 1/256 of one measurement
+		static const uint8_t AVERAGE_FRACTION_BITS = 8;
+
+		typedef struct {
+			uint8_t sw_gain;        // 2^sw_gain measurements summed per 24-bit result
+			uint8_t host_samples;   // results averaged by read_averaged()
+			uint32_t conversion_us; // nominal time for one result, excluding the ADC startup
+			                        // and any MEASRATE spacing between results
+			uint32_t total_us;      // conversion_us * host_samples
+		} Averaging;
 		
-		Si115X(uint8_t addr = DEVICE_ADDRESS);
+		Si115X(uint8_t addr = DEVICE_ADDRESS, SiBus *bus = &SiDefaultBus);
 		void config_channel(uint8_t index, const uint8_t *conf);
 		void write_data(uint8_t addr, const uint8_t *data, size_t len);
 		int read_register(uint8_t addr, uint8_t reg, int bytesOfData);
+		size_t read_block(uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
 		uint8_t read_register(uint8_t addr, uint8_t reg) {
 			return read_register(addr, reg, 1);
 		}
@@ -140,6 +172,7 @@ class Si115X
 		int get_int_from_bytes(const uint8_t *data, size_t len);
 
 		bool Begin(bool mode);
+		bool Begin(bool mode, uint8_t part_id);
 		bool Begin(void) {
 			return Begin(false);
 		}
@@ -147,9 +180,38 @@ class Si115X
 		uint16_t ReadVisible(void);
 		uint8_t ReadByte(uint8_t Reg);
 
+		static bool solve_schedule(ChannelRate *rates, uint8_t count, Schedule *schedule);
+		bool schedule_channels(ChannelRate *rates, uint8_t count);
+		uint8_t read_fresh_channels(void);
+		uint16_t read_channel(uint8_t index);
+
+		bool begin_capture(uint8_t index);
+		uint16_t capture_burst(uint16_t *samples, uint16_t count, uint16_t *period_us,
+		                       uint16_t *longest_gap = NULL);
+		void end_capture(void);
+
+		bool set_noise_target(uint8_t index, uint8_t noise_divisor, Averaging *plan);
+		uint32_t read_averaged(uint8_t index);
+
 	private:
+		bool start(bool mode);
+		uint32_t channel_period_us(uint8_t index);
+		bool read_result(uint8_t index, int32_t *value);
+
 		bool is_autonomous;
+		uint8_t chan_list;
+		// IRQ_STATUS bits read but not yet returned by read_fresh_channels()
+		uint8_t pending_irq;
+		uint8_t capture_channel;
+		bool capture_autonomous;
+		// CHAN_LIST, MEASRATE_H, MEASRATE_L, MEASCOUNT_0, MEASCONFIGx, ADCPOSTx
+		uint8_t capture_saved[6];
+		uint8_t host_samples[6];
+		uint8_t sw_gains[6];
+		// channels with 24-bit HOSTOUT slots (ADCPOSTx bit[6])
+		uint8_t wide_channels;
 		uint8_t device_address;
+		SiBus *bus;
 };
 
 #endif
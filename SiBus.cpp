@@ -0,0 +1,71 @@
+#include "SiBus.h"
+#include "SiTrace.h"
+
+SiBus SiDefaultBus;
+
+SiBus::SiBus(TwoWire *wire, SiBusLock *lock) {
+    this->wire = wire;
+    bus_lock = lock;
+    trace = NULL;
+}
+
+void SiBus::begin(void){
+    SiBusGuard guard(this);
+    wire->begin();
+}
+
+/**
+ * Writes data to a device in one transaction, returns the endTransmission() status
+ */
+uint8_t SiBus::write(uint8_t addr, const uint8_t *data, size_t len){
+    SiBusGuard guard(this);
+    uint8_t status = do_write(addr, data, len);
+
+    if(trace)
+      trace->record_write(addr, data, len, status);
+    return status;
+}
+
+/**
+ * Reads len registers starting at reg, returns the number of bytes read
+ */
+size_t SiBus::read(uint8_t addr, uint8_t reg, uint8_t *data, size_t len){
+    SiBusGuard guard(this);
+    size_t n = do_read(addr, reg, data, len);
+
+    if(trace)
+      trace->record_read(addr, reg, data, len, n);
+    return n;
+}
+
+/**
+ * Runs queued reads, possibly from different devices, under one lock acquisition
+ */
+void SiBus::read_batch(Read *reads, uint8_t count){
+    SiBusGuard guard(this);
+    for(uint8_t i = 0; i < count; i++){
+        reads[i].got = do_read(reads[i].addr, reads[i].reg, reads[i].data, reads[i].len);
+        if(trace)
+          trace->record_read(reads[i].addr, reads[i].reg, reads[i].data, reads[i].len, reads[i].got);
+    }
+}
+
+uint8_t SiBus::do_write(uint8_t addr, const uint8_t *data, size_t len){
+    wire->beginTransmission(addr);
+    wire->write(data, len);
+    return wire->endTransmission();
+}
+
+size_t SiBus::do_read(uint8_t addr, uint8_t reg, uint8_t *data, size_t len){
+    size_t n = 0;
+
+    wire->beginTransmission(addr);
+    wire->write(reg);
+    wire->endTransmission();
+    wire->requestFrom(addr, (uint8_t)len);
+
+    while(n < len && wire->available())
+      data[n++] = wire->read();
+
+    return n;
+}
@@ -0,0 +1,121 @@
+#ifndef SIBUS_H
+#define SIBUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#if !defined(SIBUS_HAVE_STD_MUTEX) && (!defined(ARDUINO) || defined(ESP32))
+#define SIBUS_HAVE_STD_MUTEX
+#endif
+
+#ifdef SIBUS_HAVE_STD_MUTEX
+#include <mutex>
+#endif
+
+/**
+ * Lock shared by every driver on one bus. It must be recursive, because
+ * a driver operation may run single transactions that take it again.
+ */
+class SiBusLock
+{
+	public:
+		virtual void lock(void) = 0;
+		virtual void unlock(void) = 0;
+};
+
+#ifdef SIBUS_HAVE_STD_MUTEX
+class SiMutexLock : public SiBusLock
+{
+	public:
+		void lock(void) {
+			mutex.lock();
+		}
+		void unlock(void) {
+			mutex.unlock();
+		}
+
+	private:
+		std::recursive_mutex mutex;
+};
+#endif
+
+class SiTraceRecorder;
+
+/**
+ * I2C bus shared by the Si114x/Si115x drivers.
+ *
+ * Every write() and read() is one transaction and holds the lock for its
+ * duration. Drivers hold it with SiBusGuard across the transactions of a
+ * multi-step operation, but never while polling or waiting, so other
+ * devices on the bus are only blocked for actual bus traffic. A driver
+ * instance itself is not reentrant: share the bus, not the driver.
+ *
+ * Without a lock (the default) the bus is assumed to be used from a
+ * single thread and locking costs nothing.
+ *
+ * With a SiTraceRecorder installed, every transaction is also logged,
+ * while the lock is held so the trace keeps the order seen on the bus.
+ */
+class SiBus
+{
+	public:
+		typedef struct {
+			uint8_t addr;
+			uint8_t reg;
+			uint8_t *data;
+			uint8_t len;
+			uint8_t got;   // bytes actually read, set by read_batch
+		} Read;
+
+		SiBus(TwoWire *wire = &Wire, SiBusLock *lock = NULL);
+		void begin(void);
+		void set_lock(SiBusLock *lock) {
+			bus_lock = lock;
+		}
+		void set_trace(SiTraceRecorder *trace) {
+			this->trace = trace;
+		}
+		void lock(void) {
+			if(bus_lock)
+			  bus_lock->lock();
+		}
+		void unlock(void) {
+			if(bus_lock)
+			  bus_lock->unlock();
+		}
+
+		uint8_t write(uint8_t addr, const uint8_t *data, size_t len);
+		size_t read(uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
+		void read_batch(Read *reads, uint8_t count);
+
+	protected:
+		virtual uint8_t do_write(uint8_t addr, const uint8_t *data, size_t len);
+		virtual size_t do_read(uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
+
+	private:
+		TwoWire *wire;
+		SiBusLock *bus_lock;
+		SiTraceRecorder *trace;
+};
+
+/**
+ * Holds the bus lock for the lifetime of the guard
+ */
+class SiBusGuard
+{
+	public:
+		SiBusGuard(SiBus *bus) : bus(bus) {
+			bus->lock();
+		}
+		~SiBusGuard() {
+			bus->unlock();
+		}
+
+	private:
+		SiBus *bus;
+};
+
+// Wire, unlocked; the drivers use it unless given another bus
+extern SiBus SiDefaultBus;
+
+#endif
@@ -0,0 +1,187 @@
+#include "SiFlicker.h"
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#endif
+
+/**
+ * Quarter wave of cos in Q14, 64 steps from 0 to pi/2
+ */
+static const uint16_t cos_table[65] PROGMEM = {
+    16384, 16379, 16364, 16340, 16305, 16261, 16207, 16143,
+    16069, 15986, 15893, 15791, 15679, 15557, 15426, 15286,
+    15137, 14978, 14811, 14635, 14449, 14256, 14053, 13842,
+    13623, 13395, 13160, 12916, 12665, 12406, 12140, 11866,
+    11585, 11297, 11003, 10702, 10394, 10080, 9760, 9434,
+    9102, 8765, 8423, 8076, 7723, 7366, 7005, 6639,
+    6270, 5897, 5520, 5139, 4756, 4370, 3981, 3590,
+    3196, 2801, 2404, 2006, 1606, 1205, 804, 402,
+    0
+};
+
+/**
+ * cos in Q14 of a phase in 1/65536 of a turn, for phases up to half a turn
+ */
+static int32_t cos_q14(uint16_t phase){
+    bool negate = false;
+
+    if(phase > 16384){
+        phase = 32768 - phase;
+        negate = true;
+    }
+
+    uint8_t i = phase >> 8;
+    int32_t a = pgm_read_word(&cos_table[i]);
+    int32_t b = i < 64 ? (int32_t)pgm_read_word(&cos_table[i + 1]) : 0;
+    int32_t value = a + (((b - a) * (int32_t)(phase & 0xFF)) >> 8);
+
+    return negate ? -value : value;
+}
+
+/**
+ * (coeff * state) >> 14 for |state| < 2^29, as two 16x16 -> 32 bit
+ * multiplies instead of a 64-bit one, which is a libgcc call on AVR
+ */
+static int32_t mul_q14(int16_t coeff, int32_t state){
+    int16_t hi = state >> 16;
+    uint16_t lo = state & 0xFFFF;
+
+    return (int32_t)coeff * hi * 4 + (((int32_t)coeff * (int32_t)lo) >> 14);
+}
+
+/**
+ * Integer square root
+ */
+static uint32_t isqrt(uint64_t value){
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while(bit > value)
+      bit >>= 2;
+    while(bit != 0){
+        if(value >= result + bit){
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+static bool near_dhz(uint16_t value, uint16_t target){
+    return value + SiFlicker::MAINS_TOLERANCE_DHZ >= target &&
+           value <= target + SiFlicker::MAINS_TOLERANCE_DHZ;
+}
+
+/**
+ * Classifies count samples taken period_us apart. Returns false if there
+ * are too few or too many samples to analyze.
+ */
+bool SiFlicker::analyze(const uint16_t *samples, uint16_t count, uint16_t period_us, Result *result){
+    result->kind = STEADY;
+    result->frequency_dhz = 0;
+    result->modulation_depth = 0;
+    result->percent_flicker = 0;
+
+    if(count < 4 || count > MAX_SAMPLES || period_us == 0)
+      return false;
+
+    uint16_t min = 0xFFFF;
+    uint16_t max = 0;
+    uint32_t sum = 0;
+    for(uint16_t i = 0; i < count; i++){
+        uint16_t s = samples[i];
+        if(s < min)
+          min = s;
+        if(s > max)
+          max = s;
+        sum += s;
+    }
+    uint16_t mean = sum / count;
+
+    if(max == 0)
+      return true;
+    result->percent_flicker = (uint32_t)(max - min) * 1000 / ((uint32_t)max + min);
+    if(result->percent_flicker < STEADY_LIMIT)
+      return true;
+
+    // Rising mean crossings, re-armed only after dipping below mean - hysteresis.
+    // Positions are in samples, Q8.
+    uint16_t hysteresis = (max - min) / 4;
+    bool armed = false;
+    uint32_t candidate = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    uint16_t crossings = 0;
+    for(uint16_t i = 1; i < count; i++){
+        uint16_t prev = samples[i - 1];
+        uint16_t s = samples[i];
+        if(s + hysteresis < mean)
+          armed = true;
+        if(!armed)
+          continue;
+        if(prev <= mean && s > mean)
+          candidate = ((uint32_t)(i - 1) << 8) + ((uint32_t)(mean - prev) << 8) / (s - prev);
+        if(s > mean + hysteresis){
+            armed = false;
+            if(crossings == 0)
+              first = candidate;
+            last = candidate;
+            crossings++;
+        }
+    }
+
+    // a single crossing does not give a period
+    if(crossings < 2)
+      return true;
+
+    uint16_t cycles = crossings - 1;
+    uint32_t cycle_q8 = (last - first) / cycles;
+    if(cycle_q8 < 512)
+      return true;
+    result->frequency_dhz = 2560000000UL / cycle_q8 / period_us;
+
+    // Goertzel over the whole cycles between the first and last crossing.
+    // Samples are scaled to 11 bits: with at least one cycle in at most
+    // MAX_SAMPLES samples the state stays below 2^28, which mul_q14 needs.
+    uint16_t begin = (first + 128) >> 8;
+    uint16_t end = (last + 128) >> 8;
+    uint16_t n = end - begin;
+    uint8_t shift = 0;
+    while(((max - min) >> shift) >= 2048)
+      shift++;
+    // 2 cos in Q14, just short of 2.0 so it fits 16 bits
+    int32_t coeff2 = 2 * cos_q14(16777216UL / cycle_q8);
+    int16_t coeff = coeff2 > 32767 ? 32767 : coeff2;
+    int32_t s1 = 0;
+    int32_t s2 = 0;
+    for(uint16_t i = begin; i < end; i++){
+        int32_t x = ((int32_t)samples[i] - mean) >> shift;
+        int32_t s0 = x + mul_q14(coeff, s1) - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    // once per block, so 64 bits are fine here
+    int64_t power = (int64_t)s1 * s1 + (int64_t)s2 * s2 - (int64_t)mul_q14(coeff, s1) * s2;
+    uint32_t magnitude = isqrt(power > 0 ? power : 0);
+    // fundamental amplitude is 2 |X| / n
+    uint32_t depth = ((uint64_t)magnitude << (shift + 1)) * 1000 / ((uint32_t)n * (mean ? mean : 1));
+    result->modulation_depth = depth > 0xFFFF ? 0xFFFF : depth;
+
+    // lamps on AC flicker at twice the mains frequency, bad drivers at the mains frequency
+    uint16_t f = result->frequency_dhz;
+    if(near_dhz(f, 1000) || near_dhz(f, 500))
+      result->kind = MAINS_50HZ;
+    else if(near_dhz(f, 1200) || near_dhz(f, 600))
+      result->kind = MAINS_60HZ;
+    else
+      result->kind = PWM;
+
+    return true;
+}
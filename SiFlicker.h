@@ -0,0 +1,47 @@
+#ifndef SIFLICKER_H
+#define SIFLICKER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Light flicker analysis of evenly spaced samples, as captured by
+ * Si115X::capture_burst(). Integer only, works in place on the caller's
+ * buffer and needs no memory besides a few locals. The per-sample loops
+ * use 16x16 -> 32 bit multiplies only, so on AVR a block costs two passes
+ * of a few 32-bit adds and two hardware multiplies per sample.
+ *
+ * The flicker frequency comes from mean crossings with hysteresis; a
+ * Goertzel filter tuned to that frequency over a whole number of cycles
+ * then gives the amplitude of the fundamental. Flicker above half the
+ * sample rate (625 Hz at the 800 us minimum period) shows up at its
+ * alias frequency and is classified as PWM.
+ */
+class SiFlicker
+{
+	public:
+		typedef enum {
+			STEADY = 0,
+			MAINS_50HZ = 1,
+			MAINS_60HZ = 2,
+			PWM = 3
+		} Kind;
+
+		typedef struct {
+			uint8_t kind;              // Kind
+			uint16_t frequency_dhz;    // flicker frequency in 0.1 Hz, 0 when steady
+			uint16_t modulation_depth; // fundamental amplitude / mean, in 0.1 %
+			uint16_t percent_flicker;  // (max - min) / (max + min), in 0.1 %
+		} Result;
+
+		// Bounds the Goertzel state to 32 bits
+		static const uint16_t MAX_SAMPLES = 1024;
+		// Below this percent flicker (0.1 % units) the light is steady
+		static const uint16_t STEADY_LIMIT = 10;
+		// Allowed distance from 100/120 Hz (or 50/60 Hz) for mains, 0.1 Hz
+		static const uint16_t MAINS_TOLERANCE_DHZ = 30;
+
+		static bool analyze(const uint16_t *samples, uint16_t count, uint16_t period_us, Result *result);
+};
+
+#endif
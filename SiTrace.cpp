@@ -0,0 +1,190 @@
+#include "SiTrace.h"
+
+SiTraceRecorder::SiTraceRecorder(Print *out) {
+    this->out = out;
+    last_us = 0;
+    count = 0;
+}
+
+/**
+ * Writes the header and starts the clock
+ */
+void SiTraceRecorder::begin(void){
+    const uint8_t header[SiTrace::HEADER_SIZE] = {'S', 'I', 'T', SiTrace::VERSION};
+
+    out->write(header, sizeof(header));
+    last_us = micros();
+    count = 0;
+}
+
+/**
+ * Puts the time since the previous record into buf as a varint, returns its length
+ */
+uint8_t SiTraceRecorder::put_time(uint8_t *buf){
+    uint32_t now = micros();
+    uint32_t dt = now - last_us;
+    uint8_t n = 0;
+
+    last_us = now;
+    while(dt >= 0x80){
+        buf[n++] = (dt & 0x7F) | 0x80;
+        dt >>= 7;
+    }
+    buf[n++] = dt;
+    return n;
+}
+
+void SiTraceRecorder::record_write(uint8_t addr, const uint8_t *data, size_t len, uint8_t status){
+    uint8_t buf[10];
+    uint8_t n = 0;
+
+    buf[n++] = SiTrace::WRITE;
+    n += put_time(buf + n);
+    buf[n++] = addr;
+    buf[n++] = status;
+    buf[n++] = len;
+    out->write(buf, n);
+    out->write(data, len);
+    count++;
+}
+
+void SiTraceRecorder::record_read(uint8_t addr, uint8_t reg, const uint8_t *data, size_t requested, size_t len){
+    uint8_t buf[11];
+    uint8_t n = 0;
+
+    buf[n++] = SiTrace::READ;
+    n += put_time(buf + n);
+    buf[n++] = addr;
+    buf[n++] = reg;
+    buf[n++] = requested;
+    buf[n++] = len;
+    out->write(buf, n);
+    out->write(data, len);
+    count++;
+}
+
+SiTraceReader::SiTraceReader(const uint8_t *trace, size_t size) {
+    this->trace = trace;
+    this->size = size;
+    rewind();
+}
+
+bool SiTraceReader::valid(void){
+    return size >= SiTrace::HEADER_SIZE && trace[0] == 'S' && trace[1] == 'I' && trace[2] == 'T' &&
+           trace[3] == SiTrace::VERSION;
+}
+
+void SiTraceReader::rewind(void){
+    pos = SiTrace::HEADER_SIZE;
+    time_us = 0;
+}
+
+/**
+ * Decodes the next record, returns false at the end of the trace or on a truncated record
+ */
+bool SiTraceReader::next(SiTrace::Record *record){
+    if(!valid() || pos >= size)
+      return false;
+
+    size_t p = pos;
+    uint8_t type = trace[p++];
+    if(type != SiTrace::WRITE && type != SiTrace::READ)
+      return false;
+
+    uint32_t dt = 0;
+    uint8_t shift = 0;
+    do {
+        if(p >= size || shift > 28)
+          return false;
+        dt |= (uint32_t)(trace[p] & 0x7F) << shift;
+        shift += 7;
+    } while(trace[p++] & 0x80);
+
+    size_t fields = type == SiTrace::WRITE ? 3 : 4;
+    if(p + fields > size)
+      return false;
+
+    record->type = type;
+    record->addr = trace[p++];
+    if(type == SiTrace::WRITE){
+        record->reg = 0;
+        record->status = trace[p++];
+        record->requested = 0;
+    }
+    else {
+        record->reg = trace[p++];
+        record->status = 0;
+        record->requested = trace[p++];
+    }
+    record->len = trace[p++];
+    if(p + record->len > size)
+      return false;
+    record->data = trace + p;
+
+    time_us += dt;
+    record->time_us = time_us;
+    pos = p + record->len;
+    return true;
+}
+
+SiReplayBus::SiReplayBus(const uint8_t *trace, size_t size) : reader(trace, size) {
+    SiTraceReader all = reader;
+    SiTrace::Record record;
+
+    matched_count = 0;
+    skipped_count = 0;
+    extra_count = 0;
+    total_count = 0;
+    consumed_count = 0;
+    while(all.next(&record))
+      total_count++;
+}
+
+/**
+ * Finds the next record matching a transaction within LOOKAHEAD records,
+ * counting the records passed over. Reads match on the register, writes
+ * on their bytes.
+ */
+bool SiReplayBus::find(uint8_t type, uint8_t addr, uint8_t reg, const uint8_t *data, size_t len,
+                       SiTrace::Record *record){
+    SiTraceReader ahead = reader;
+    uint32_t skipped = 0;
+
+    while(skipped < LOOKAHEAD && ahead.next(record)){
+        bool match = record->type == type && record->addr == addr;
+        if(match && type == SiTrace::READ)
+          match = record->reg == reg;
+        if(match && type == SiTrace::WRITE)
+          match = record->len == len && memcmp(record->data, data, len) == 0;
+        if(match){
+            reader = ahead;
+            skipped_count += skipped;
+            matched_count++;
+            consumed_count += skipped + 1;
+            return true;
+        }
+        skipped++;
+    }
+    extra_count++;
+    return false;
+}
+
+uint8_t SiReplayBus::do_write(uint8_t addr, const uint8_t *data, size_t len){
+    SiTrace::Record record;
+
+    // unmatched writes look like a missing device
+    if(!find(SiTrace::WRITE, addr, 0, data, len, &record))
+      return 2;
+    return record.status;
+}
+
+size_t SiReplayBus::do_read(uint8_t addr, uint8_t reg, uint8_t *data, size_t len){
+    SiTrace::Record record;
+
+    if(!find(SiTrace::READ, addr, reg, NULL, len, &record))
+      return 0;
+
+    size_t n = record.len < len ? record.len : len;
+    memcpy(data, record.data, n);
+    return n;
+}
@@ -0,0 +1,130 @@
+#ifndef SITRACE_H
+#define SITRACE_H
+
+#include <Arduino.h>
+#include "SiBus.h"
+
+/**
+ * Binary trace of the transactions on an SiBus.
+ *
+ * The trace starts with "SIT" and a version byte, followed by records:
+ *   'W', dt, addr, status, len, data[len]
+ *   'R', dt, addr, reg, requested, len, data[len]
+ * dt is the time since the previous record (or since begin()) in
+ * microseconds, as an unsigned LEB128 varint. A read of RESPONSE_0 while
+ * polling takes 7 bytes.
+ */
+class SiTrace
+{
+	public:
+		typedef enum {
+			WRITE = 'W',
+			READ = 'R'
+		} RecordType;
+
+		static const uint8_t VERSION = 1;
+		static const uint8_t HEADER_SIZE = 4;
+
+		typedef struct {
+			uint8_t type;         // RecordType
+			uint32_t time_us;     // since the start of the trace
+			uint8_t addr;
+			uint8_t reg;          // reads only
+			uint8_t status;       // writes only, endTransmission() status
+			uint8_t requested;    // reads only, bytes asked for
+			uint8_t len;          // bytes in data
+			const uint8_t *data;
+		} Record;
+};
+
+/**
+ * Writes the trace of a bus to any Print (Serial, an SD card File...).
+ * Install it with SiBus::set_trace(); writing to out takes time, so keep
+ * it fast or buffered to disturb the timing as little as possible.
+ */
+class SiTraceRecorder
+{
+	public:
+		SiTraceRecorder(Print *out);
+		void begin(void);
+		void record_write(uint8_t addr, const uint8_t *data, size_t len, uint8_t status);
+		void record_read(uint8_t addr, uint8_t reg, const uint8_t *data, size_t requested, size_t len);
+		uint32_t records(void) {
+			return count;
+		}
+
+	private:
+		uint8_t put_time(uint8_t *buf);
+
+		Print *out;
+		uint32_t last_us;
+		uint32_t count;
+};
+
+/**
+ * Walks the records of a trace held in memory
+ */
+class SiTraceReader
+{
+	public:
+		SiTraceReader(const uint8_t *trace, size_t size);
+		bool valid(void);
+		bool next(SiTrace::Record *record);
+		void rewind(void);
+
+	private:
+		const uint8_t *trace;
+		size_t size;
+		size_t pos;
+		uint32_t time_us;
+};
+
+/**
+ * Fake bus that answers the drivers from a recorded trace.
+ *
+ * Each transaction is matched against the next record of the same type
+ * and address, with the same register for reads and the same bytes for
+ * writes, looking at most LOOKAHEAD records ahead. Records passed over to
+ * find it are counted as skipped. A transaction with no match in that
+ * window counts as extra and leaves the position in the trace unchanged,
+ * so one extra poll does not throw the rest of the replay out of step. A
+ * session reproduced exactly has neither. Reads return the recorded
+ * bytes, writes the recorded status.
+ */
+class SiReplayBus : public SiBus
+{
+	public:
+		static const uint8_t LOOKAHEAD = 16;
+
+		SiReplayBus(const uint8_t *trace, size_t size);
+		uint32_t matched(void) {
+			return matched_count;
+		}
+		uint32_t skipped(void) {
+			return skipped_count;
+		}
+		uint32_t extra(void) {
+			return extra_count;
+		}
+		// records not consumed yet
+		uint32_t remaining(void) {
+			return total_count - consumed_count;
+		}
+
+	protected:
+		uint8_t do_write(uint8_t addr, const uint8_t *data, size_t len);
+		size_t do_read(uint8_t addr, uint8_t reg, uint8_t *data, size_t len);
+
+	private:
+		bool find(uint8_t type, uint8_t addr, uint8_t reg, const uint8_t *data, size_t len,
+		          SiTrace::Record *record);
+
+		SiTraceReader reader;
+		uint32_t matched_count;
+		uint32_t skipped_count;
+		uint32_t extra_count;
+		uint32_t total_count;
+		uint32_t consumed_count;
+};
+
+#endif
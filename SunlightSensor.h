@@ -0,0 +1,221 @@
+#ifndef SUNLIGHTSENSOR_H
+#define SUNLIGHTSENSOR_H
+
+#include <Arduino.h>
+#include "SiBus.h"
+
+/*
+    Define SUNLIGHT_NO_SI114X or SUNLIGHT_NO_SI115X before including this
+    header to leave that chip out. This class is implemented here so the
+    defines in a sketch take effect, and the linker then drops the unused
+    driver.
+
+    The defines change the layout of the class, so every file of a
+    program that includes this header must see the same ones, e.g. by
+    defining them before every include or for the whole build. Nothing
+    checks this; a sensor shared between files that disagree is
+    undefined behavior.
+*/
+#if defined(SUNLIGHT_NO_SI114X) && defined(SUNLIGHT_NO_SI115X)
+#error "SunlightSensor needs at least one of the Si114x and Si115x drivers"
+#endif
+
+#ifndef SUNLIGHT_NO_SI114X
+#include "SI114X.h"
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+#include "Si115X.h"
+#endif
+
+/**
+ * Finds whichever supported light sensor is on the bus and samples it
+ * through one interface.
+ *
+ * probe() reads PART_ID and REV_ID of every known address in a single
+ * batch under one bus lock acquisition, and Begin() then starts the
+ * matching driver without reading the ids again. Reads dispatch on the
+ * detected chip with a switch, without virtual calls.
+ */
+class SunlightSensor
+{
+	public:
+		typedef enum {
+			NONE = 0,
+			SI114X_CHIP = 1,   // Si1145/46/47 at 0x60
+			SI115X_CHIP = 2    // Si1151 at 0x53
+		} Chip;
+
+		typedef struct {
+			uint8_t chip;      // Chip
+			uint8_t addr;
+			uint8_t part_id;
+			uint8_t rev_id;
+		} Device;
+
+		SunlightSensor(SiBus *bus = &SiDefaultBus)
+			: bus(bus)
+#ifndef SUNLIGHT_NO_SI114X
+			, si114x(bus)
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+			, si115x(Si115X::DEVICE_ADDRESS, bus)
+#endif
+		{
+			device.chip = NONE;
+			device.addr = 0;
+			device.part_id = 0;
+			device.rev_id = 0;
+		}
+
+		/**
+		 * Fills found with up to max supported devices present on the bus,
+		 * returns how many were found
+		 */
+		static uint8_t probe(SiBus *bus, Device *found, uint8_t max) {
+			const Device known[] = {
+#ifndef SUNLIGHT_NO_SI114X
+				{SI114X_CHIP, SI114X_ADDR, 0, 0},
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+				{SI115X_CHIP, Si115X::DEVICE_ADDRESS, 0, 0},
+#endif
+			};
+			const uint8_t count = sizeof(known) / sizeof(known[0]);
+			uint8_t ids[count][2];
+			SiBus::Read reads[count];
+
+			// PART_ID and REV_ID are registers 0 and 1 on both families
+			for(uint8_t i = 0; i < count; i++){
+				reads[i].addr = known[i].addr;
+				reads[i].reg = 0x00;
+				reads[i].data = ids[i];
+				reads[i].len = 2;
+			}
+			bus->read_batch(reads, count);
+
+			uint8_t n = 0;
+			for(uint8_t i = 0; i < count && n < max; i++){
+				if(reads[i].got != 2 || !supported(known[i].chip, ids[i][0]))
+				  continue;
+				found[n] = known[i];
+				found[n].part_id = ids[i][0];
+				found[n].rev_id = ids[i][1];
+				n++;
+			}
+			return n;
+		}
+
+		/**
+		 * Starts the first supported device found on the bus
+		 */
+		bool Begin(void) {
+			bus->begin();
+			if(probe(bus, &device, 1) == 0){
+				device.chip = NONE;
+				return false;
+			}
+
+			switch(device.chip){
+#ifndef SUNLIGHT_NO_SI114X
+				case SI114X_CHIP:
+					return si114x.Begin(device.part_id, device.rev_id);
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+				case SI115X_CHIP:
+					return si115x.Begin(false, device.part_id);
+#endif
+				default:
+					return false;
+			}
+		}
+
+		uint8_t chip(void) {
+			return device.chip;
+		}
+		const Device *detected(void) {
+			return &device;
+		}
+		bool has_uv(void) {
+			return device.chip == SI114X_CHIP;
+		}
+
+		uint16_t ReadVisible(void) {
+			switch(device.chip){
+#ifndef SUNLIGHT_NO_SI114X
+				case SI114X_CHIP:
+					return si114x.ReadVisible();
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+				case SI115X_CHIP:
+					return si115x.ReadVisible();
+#endif
+				default:
+					return 0;
+			}
+		}
+
+		uint16_t ReadIR(void) {
+			switch(device.chip){
+#ifndef SUNLIGHT_NO_SI114X
+				case SI114X_CHIP:
+					return si114x.ReadIR();
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+				case SI115X_CHIP:
+					return si115x.ReadIR();
+#endif
+				default:
+					return 0;
+			}
+		}
+
+		// UV index * 100, 0 on chips without UV
+		uint16_t ReadUV(void) {
+			switch(device.chip){
+#ifndef SUNLIGHT_NO_SI114X
+				case SI114X_CHIP:
+					return si114x.ReadUV();
+#endif
+				default:
+					return 0;
+			}
+		}
+
+#ifndef SUNLIGHT_NO_SI114X
+		SI114X *si114x_driver(void) {
+			return device.chip == SI114X_CHIP ? &si114x : NULL;
+		}
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+		Si115X *si115x_driver(void) {
+			return device.chip == SI115X_CHIP ? &si115x : NULL;
+		}
+#endif
+
+	private:
+		static bool supported(uint8_t chip, uint8_t part_id) {
+			switch(chip){
+#ifndef SUNLIGHT_NO_SI114X
+				case SI114X_CHIP:
+					return part_id >= SI114X_PART_ID_SI1145 && part_id <= SI114X_PART_ID_SI1147;
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+				case SI115X_CHIP:
+					return part_id == Si115X::PART_ID_SI1151;
+#endif
+				default:
+					return false;
+			}
+		}
+
+		SiBus *bus;
+		Device device;
+#ifndef SUNLIGHT_NO_SI114X
+		SI114X si114x;
+#endif
+#ifndef SUNLIGHT_NO_SI115X
+		Si115X si115x;
+#endif
+};
+
+#endif
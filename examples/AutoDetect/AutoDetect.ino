@@ -0,0 +1,37 @@
+/*
+    Runs on any Grove - Sunlight Sensor: detects whether an Si1145/46/47
+    or an Si1151 is connected and reads it through one interface.
+
+    To save flash on boards with a known chip, leave the other one out:
+    #define SUNLIGHT_NO_SI114X
+    #define SUNLIGHT_NO_SI115X
+*/
+
+#include "SunlightSensor.h"
+
+SunlightSensor sensor;
+
+void setup() {
+    Serial.begin(115200);
+
+    while (!sensor.Begin()) {
+        Serial.println("No sunlight sensor found!");
+        delay(1000);
+    }
+    Serial.print(sensor.chip() == SunlightSensor::SI114X_CHIP ? "Si114" : "Si115");
+    Serial.print(sensor.detected()->part_id & 0x0F);
+    Serial.print(" rev ");
+    Serial.print(sensor.detected()->rev_id);
+    Serial.println(" is ready!");
+}
+
+void loop() {
+    Serial.print("//--------------------------------------//\r\n");
+    Serial.print("Vis: "); Serial.println(sensor.ReadVisible());
+    Serial.print("IR: "); Serial.println(sensor.ReadIR());
+    if (sensor.has_uv()) {
+        //the real UV value must be div 100 from the reg value , datasheet for more information.
+        Serial.print("UV: ");  Serial.println((float)sensor.ReadUV() / 100);
+    }
+    delay(1000);
+}
@@ -0,0 +1,70 @@
+#include "Si115X.h"
+#include "SiFlicker.h"
+
+Si115X si1151;
+
+// 256 samples at 800 us cover about 20 mains cycles
+uint16_t samples[256];
+// bursts with a longer run of missed samples than this are not analyzed,
+// since a stall of a few slots can hide whole flicker cycles
+const uint16_t MAX_GAP = 2;
+
+/**
+ * Setup for configuration
+ */
+void setup()
+{
+    Serial.begin(115200);
+    if (!si1151.Begin()) {
+        Serial.println("Si1151 is not ready!");
+        while (1) {
+            delay(1000);
+            Serial.print(".");
+        };
+    }
+    else {
+        Serial.println("Si1151 is ready!");
+    }
+    // reading one result per 800 us period needs a fast bus
+    Wire.setClock(400000);
+}
+
+/**
+ * Captures a burst of the visible channel and classifies its flicker
+ */
+void loop()
+{
+    uint16_t period_us;
+    uint16_t longest_gap;
+    SiFlicker::Result result;
+
+    si1151.begin_capture(1);
+    uint16_t count = si1151.capture_burst(samples, 256, &period_us, &longest_gap);
+    si1151.end_capture();
+
+    if (longest_gap > MAX_GAP) {
+        Serial.print("Bus too slow, missed ");
+        Serial.print(longest_gap);
+        Serial.println(" samples in a row");
+    }
+    else if (!SiFlicker::analyze(samples, count, period_us, &result)) {
+        Serial.println("Capture failed");
+    }
+    else {
+        switch (result.kind) {
+            case SiFlicker::MAINS_50HZ: Serial.print("50 Hz mains"); break;
+            case SiFlicker::MAINS_60HZ: Serial.print("60 Hz mains"); break;
+            case SiFlicker::PWM: Serial.print("PWM"); break;
+            default: Serial.print("Steady"); break;
+        }
+        Serial.print(", ");
+        Serial.print(result.frequency_dhz / 10.0);
+        Serial.print(" Hz, depth ");
+        Serial.print(result.modulation_depth / 10.0);
+        Serial.print(" %, flicker ");
+        Serial.print(result.percent_flicker / 10.0);
+        Serial.println(" %");
+    }
+
+    delay(1000);
+}
@@ -0,0 +1,144 @@
+/*
+    bus_contention_bench.cpp
+    Host benchmark of SiBus arbitration with several threads sharing one bus.
+
+    Each thread plays a driver doing param_set-like operations (three
+    transactions under SiBusGuard, then an unlocked poll) on its own
+    device. Transactions are simulated as busy time proportional to the
+    bytes on the wire. Without a lock, operations from different threads
+    interleave; with one they never do. The last part compares one lock
+    acquisition per read against SiBus::read_batch().
+
+    Build and run from this directory:
+        g++ -std=c++17 -O2 -pthread -I../host -I../.. bus_contention_bench.cpp ../../SiBus.cpp ../../SiTrace.cpp \
+            -o bus_contention_bench
+        ./bus_contention_bench
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "SiBus.h"
+
+// 2.5 us per byte, ten times faster than a 400 kHz bus to keep runs short
+static const long BYTE_NS = 2500;
+static const int OPS_PER_THREAD = 500;
+static const int DEVICES = 4;
+
+class SimBus : public SiBus
+{
+	public:
+		std::atomic<uint32_t> transactions{0};
+		std::atomic<uint32_t> interleaved{0};
+
+	protected:
+		uint8_t do_write(uint8_t, const uint8_t *, size_t len) {
+			busy(len + 1);
+			return 0;
+		}
+		size_t do_read(uint8_t, uint8_t, uint8_t *data, size_t len) {
+			busy(len + 3);
+			memset(data, 0, len);
+			return len;
+		}
+
+	private:
+		void busy(size_t bytes) {
+			transactions++;
+			auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(BYTE_NS * bytes);
+			while(std::chrono::steady_clock::now() < end)
+			  ;
+		}
+};
+
+static void logical_op(SimBus *bus, uint8_t addr){
+    uint8_t packet[2] = {0, 0};
+    uint8_t response;
+    {
+        SiBusGuard guard(bus);
+        uint32_t before = bus->transactions;
+        bus->read(addr, 0x11, &response, 1);
+        bus->write(addr, packet, 2);
+        bus->write(addr, packet, 2);
+        if(bus->transactions - before != 3)
+          bus->interleaved++;
+    }
+    // poll for the response without holding the bus
+    for(int i = 0; i < 2; i++)
+      bus->read(addr, 0x11, &response, 1);
+}
+
+static double run_ops(SimBus *bus, int threads){
+    std::vector<std::thread> pool;
+    auto start = std::chrono::steady_clock::now();
+    for(int t = 0; t < threads; t++){
+        pool.emplace_back([bus, t]{
+            for(int i = 0; i < OPS_PER_THREAD; i++)
+              logical_op(bus, 0x50 + t);
+        });
+    }
+    for(auto &th : pool)
+      th.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double run_reads(SimBus *bus, int threads, bool batched){
+    std::vector<std::thread> pool;
+    auto start = std::chrono::steady_clock::now();
+    for(int t = 0; t < threads; t++){
+        pool.emplace_back([bus, batched]{
+            uint8_t data[DEVICES][2];
+            SiBus::Read reads[DEVICES];
+            for(int d = 0; d < DEVICES; d++)
+              reads[d] = {(uint8_t)(0x50 + d), 0x13, data[d], 2, 0};
+            for(int i = 0; i < OPS_PER_THREAD; i++){
+                if(batched){
+                    bus->read_batch(reads, DEVICES);
+                }
+                else {
+                    for(int d = 0; d < DEVICES; d++)
+                      bus->read(reads[d].addr, reads[d].reg, reads[d].data, reads[d].len);
+                }
+            }
+        });
+    }
+    for(auto &th : pool)
+      th.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(){
+    const int counts[] = {1, 2, 4, 8};
+
+    printf("param_set-like operations, %d per thread\n", OPS_PER_THREAD);
+    for(int threads : counts){
+        SimBus unlocked;
+        double t0 = run_ops(&unlocked, threads);
+
+        SiMutexLock mutex;
+        SimBus locked;
+        locked.set_lock(&mutex);
+        double t1 = run_ops(&locked, threads);
+
+        int ops = threads * OPS_PER_THREAD;
+        printf("  %d threads: no lock %7.0f ops/s, %5u interleaved | SiMutexLock %7.0f ops/s, %5u interleaved\n",
+               threads, ops / t0, (unsigned)unlocked.interleaved, ops / t1, (unsigned)locked.interleaved);
+    }
+
+    printf("reads of %d devices, %d rounds per thread, SiMutexLock\n", DEVICES, OPS_PER_THREAD);
+    for(int threads : counts){
+        SiMutexLock mutex;
+        SimBus bus;
+        bus.set_lock(&mutex);
+        double single = run_reads(&bus, threads, false);
+        double batched = run_reads(&bus, threads, true);
+
+        int rounds = threads * OPS_PER_THREAD;
+        printf("  %d threads: one lock per read %7.1f us/round | read_batch %7.1f us/round\n",
+               threads, single * 1e6 / rounds, batched * 1e6 / rounds);
+    }
+    return 0;
+}
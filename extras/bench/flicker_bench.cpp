@@ -0,0 +1,72 @@
+/*
+    flicker_bench.cpp
+    Host benchmark of SiFlicker::analyze() on synthetic captures.
+
+    Build and run from this directory:
+        g++ -O2 -I../.. flicker_bench.cpp ../../SiFlicker.cpp -o flicker_bench
+        ./flicker_bench
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "SiFlicker.h"
+
+static const uint16_t PERIOD_US = 800;
+static const int ITERATIONS = 20000;
+
+static const char *kind_name(uint8_t kind){
+    switch(kind){
+        case SiFlicker::MAINS_50HZ: return "50 Hz mains";
+        case SiFlicker::MAINS_60HZ: return "60 Hz mains";
+        case SiFlicker::PWM: return "PWM";
+        default: return "steady";
+    }
+}
+
+/**
+ * mean plus a sine (or a square wave when duty is given) at freq, with uniform noise
+ */
+static void synth(uint16_t *samples, uint16_t count, double freq, double mean, double depth,
+                  double duty, double noise){
+    for(uint16_t i = 0; i < count; i++){
+        double phase = std::fmod(freq * i * PERIOD_US * 1e-6, 1.0);
+        double wave = duty > 0 ? (phase < duty ? 1.0 : -1.0) : std::sin(2 * M_PI * phase);
+        double v = mean * (1 + depth * wave) + noise * (std::rand() / (double)RAND_MAX - 0.5);
+        samples[i] = v < 0 ? 0 : (v > 65535 ? 65535 : (uint16_t)v);
+    }
+}
+
+int main(){
+    static uint16_t samples[SiFlicker::MAX_SAMPLES];
+    struct {
+        const char *name;
+        double freq, mean, depth, duty, noise;
+    } cases[] = {
+        {"incandescent 50 Hz", 100, 2000, 0.10, 0, 20},
+        {"fluorescent 60 Hz", 120, 3000, 0.35, 0, 20},
+        {"LED PWM 300 Hz", 300, 1500, 0.80, 0.3, 10},
+        {"daylight", 0, 4000, 0, 0, 10},
+    };
+    const uint16_t sizes[] = {128, 256, 1024};
+
+    for(auto &c : cases){
+        for(uint16_t count : sizes){
+            synth(samples, count, c.freq, c.mean, c.depth, c.duty, c.noise);
+
+            SiFlicker::Result result;
+            auto start = std::chrono::steady_clock::now();
+            for(int i = 0; i < ITERATIONS; i++)
+              SiFlicker::analyze(samples, count, PERIOD_US, &result);
+            auto end = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+
+            printf("%-20s n=%4u  %-12s %6.1f Hz  depth %5.1f %%  flicker %5.1f %%  %8.0f ns/block\n",
+                   c.name, count, kind_name(result.kind), result.frequency_dhz / 10.0,
+                   result.modulation_depth / 10.0, result.percent_flicker / 10.0, ns);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+    Minimal Arduino API for building the library on a host (Linux, macOS)
+    for the benchmarks and tools under extras/. Not used on a board.
+*/
+#ifndef ARDUINO_HOST_H
+#define ARDUINO_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+inline unsigned long micros(void) {
+    using namespace std::chrono;
+    return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis(void) {
+    return micros() / 1000;
+}
+
+inline void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(unsigned int us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+inline void yield(void) {
+    std::this_thread::yield();
+}
+
+class Print
+{
+	public:
+		virtual size_t write(uint8_t) = 0;
+		virtual size_t write(const uint8_t *buffer, size_t size) {
+			size_t n = 0;
+			while(n < size && write(buffer[n]))
+			  n++;
+			return n;
+		}
+};
+
+#endif
@@ -0,0 +1,39 @@
+/*
+    Host stand-in for the Arduino Wire library: a bus with no devices.
+    Tools give the drivers an SiBus subclass instead of talking to it.
+*/
+#ifndef WIRE_HOST_H
+#define WIRE_HOST_H
+
+#include "Arduino.h"
+
+class TwoWire
+{
+	public:
+		void begin(void) {}
+		void setClock(uint32_t) {}
+		void beginTransmission(uint8_t) {}
+		size_t write(uint8_t) {
+			return 1;
+		}
+		size_t write(const uint8_t *, size_t len) {
+			return len;
+		}
+		// 2: address not acknowledged
+		uint8_t endTransmission(bool = true) {
+			return 2;
+		}
+		uint8_t requestFrom(uint8_t, uint8_t) {
+			return 0;
+		}
+		int available(void) {
+			return 0;
+		}
+		int read(void) {
+			return -1;
+		}
+};
+
+inline TwoWire Wire;
+
+#endif
@@ -0,0 +1,324 @@
+/*
+    si_trace.cpp
+    Host tool for bus traces written by SiTraceRecorder.
+
+        si_trace dump TRACE
+        si_trace diff [--model-only] OLD NEW [CLOCK_HZ]
+        si_trace replay si1145|si1151 TRACE [OUT]
+
+    diff compares two traces, e.g. the same session recorded with two
+    library versions: transaction counts per device and register, bytes
+    on the bus, and time both as recorded and as modeled.
+    - Recorded time is the session length and, per device and register,
+      the sum of the recorded dt before each transaction, so a longer
+      delay() or poll wait shows up at the transaction after it.
+    - Modeled bus time is computed from the bytes of each transaction at
+      CLOCK_HZ (100 kHz by default): 9 bit times per byte plus a start
+      and a stop per addressed phase.
+    A trace written by replay has host timestamps, so compare it with
+    --model-only, which leaves the recorded time out.
+
+    replay runs the driver of this tree against a trace as a fake bus,
+    following the demo sketches (Begin, then reading every channel until
+    the trace is used up), and reports how closely it reproduces the
+    recorded session. OUT receives the trace of the replayed session for
+    diff, up to the transaction where the replay left the trace for
+    good. For other firmware, copy run_si1145()/run_si1151() and make
+    the same calls as the firmware.
+
+    Build from this directory:
+        g++ -std=c++17 -O2 -I../host -I../.. si_trace.cpp ../../SiTrace.cpp ../../SiBus.cpp \
+            ../../SI114X.cpp ../../Si115X.cpp -o si_trace
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "SI114X.h"
+#include "Si115X.h"
+#include "SiTrace.h"
+
+// consecutive unmatched transactions after which a replay is given up
+static const uint32_t MAX_EXTRA = 1000;
+
+/**
+ * Print that keeps the replayed trace in memory, so the unmatched
+ * transactions at its end can be dropped before it is saved
+ */
+class BufferPrint : public Print
+{
+	public:
+		size_t write(uint8_t c) {
+			data.push_back(c);
+			return 1;
+		}
+		size_t write(const uint8_t *buffer, size_t size) {
+			data.insert(data.end(), buffer, buffer + size);
+			return size;
+		}
+
+		std::vector<uint8_t> data;
+};
+
+/**
+ * Replay bus that stops the tool once the driver has left the trace for
+ * good, since the drivers poll RESPONSE without a timeout
+ */
+class ToolReplayBus : public SiReplayBus
+{
+	public:
+		ToolReplayBus(const uint8_t *trace, size_t size) : SiReplayBus(trace, size) {}
+		void (*report)(ToolReplayBus *bus) = NULL;
+		// replayed trace, if any
+		BufferPrint *out = NULL;
+		// size of out before the current run of unmatched transactions
+		size_t out_matched = 0;
+		uint32_t unmatched = 0;
+
+	protected:
+		uint8_t do_write(uint8_t addr, const uint8_t *data, size_t len) {
+			uint32_t before = matched();
+			uint8_t status = SiReplayBus::do_write(addr, data, len);
+			check(before);
+			return status;
+		}
+		size_t do_read(uint8_t addr, uint8_t reg, uint8_t *data, size_t len) {
+			uint32_t before = matched();
+			size_t n = SiReplayBus::do_read(addr, reg, data, len);
+			check(before);
+			return n;
+		}
+
+	private:
+		// runs before SiBus records the transaction
+		void check(uint32_t before) {
+			if(matched() != before){
+				unmatched = 0;
+				return;
+			}
+			if(unmatched++ == 0 && out != NULL)
+			  out_matched = out->data.size();
+			if(unmatched >= MAX_EXTRA || remaining() == 0){
+				report(this);
+				exit(0);
+			}
+		}
+};
+
+static std::vector<uint8_t> load(const char *path){
+    std::vector<uint8_t> data;
+    FILE *file = fopen(path, "rb");
+    if(file == NULL){
+        perror(path);
+        exit(1);
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), file)) > 0)
+      data.insert(data.end(), buf, buf + n);
+    fclose(file);
+
+    SiTraceReader reader(data.data(), data.size());
+    if(!reader.valid()){
+        fprintf(stderr, "%s: not a version %u trace\n", path, SiTrace::VERSION);
+        exit(1);
+    }
+    return data;
+}
+
+static int dump(const char *path){
+    std::vector<uint8_t> trace = load(path);
+    SiTraceReader reader(trace.data(), trace.size());
+    SiTrace::Record record;
+
+    while(reader.next(&record)){
+        printf("%10u us  %c 0x%02x", record.time_us, record.type, record.addr);
+        if(record.type == SiTrace::READ)
+          printf(" reg 0x%02x %u/%u:", record.reg, record.len, record.requested);
+        else
+          printf(" status %u:", record.status);
+        for(uint8_t i = 0; i < record.len; i++)
+          printf(" %02x", record.data[i]);
+        printf("\n");
+    }
+    return 0;
+}
+
+// type, device, register (the first byte written for writes)
+typedef std::tuple<char, uint8_t, uint8_t> Key;
+
+typedef struct {
+    uint32_t count;
+    uint32_t time_us;     // recorded dt before these transactions
+} Usage;
+
+typedef struct {
+    std::map<Key, Usage> usage;
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t bits;
+    uint32_t duration_us;
+} Summary;
+
+static Summary summarize(const std::vector<uint8_t> &trace){
+    SiTraceReader reader(trace.data(), trace.size());
+    SiTrace::Record record;
+    Summary summary = {};
+
+    while(reader.next(&record)){
+        uint8_t reg = record.type == SiTrace::READ ? record.reg : (record.len ? record.data[0] : 0);
+        Usage &usage = summary.usage[Key(record.type, record.addr, reg)];
+        usage.count++;
+        usage.time_us += record.time_us - summary.duration_us;
+        summary.duration_us = record.time_us;
+        summary.transactions++;
+        // address byte, plus the register pointer write and read address for reads
+        uint32_t bytes = record.type == SiTrace::READ ? record.len + 3 : record.len + 1;
+        summary.bytes += bytes;
+        // reads are a register pointer write and a read, two addressed phases
+        summary.bits += bytes * 9 + (record.type == SiTrace::READ ? 4 : 2);
+    }
+    return summary;
+}
+
+static void print_row(const char *label, uint32_t a, uint32_t b){
+    printf("%-15s %8u %8u %+8ld\n", label, a, b, (long)b - (long)a);
+}
+
+static int diff(const char *old_path, const char *new_path, uint32_t clock_hz, bool model_only){
+    Summary a = summarize(load(old_path));
+    Summary b = summarize(load(new_path));
+    std::map<Key, std::pair<Usage, Usage> > rows;
+
+    for(auto &u : a.usage)
+      rows[u.first].first = u.second;
+    for(auto &u : b.usage)
+      rows[u.first].second = u.second;
+
+    printf("       dev  reg      old      new    delta");
+    if(!model_only)
+      printf("   old us   new us    delta");
+    printf("\n");
+    for(auto &r : rows){
+        const Usage &old_usage = r.second.first;
+        const Usage &new_usage = r.second.second;
+        printf("%-5s 0x%02x 0x%02x %8u %8u %+8ld", std::get<0>(r.first) == SiTrace::READ ? "read" : "write",
+               std::get<1>(r.first), std::get<2>(r.first), old_usage.count, new_usage.count,
+               (long)new_usage.count - (long)old_usage.count);
+        if(!model_only)
+          printf(" %8u %8u %+8ld", old_usage.time_us, new_usage.time_us,
+                 (long)new_usage.time_us - (long)old_usage.time_us);
+        printf("\n");
+    }
+    print_row("transactions", a.transactions, b.transactions);
+    print_row("bytes", a.bytes, b.bytes);
+    if(!model_only)
+      print_row("recorded (us)", a.duration_us, b.duration_us);
+    uint32_t a_us = (uint64_t)a.bits * 1000000 / clock_hz;
+    uint32_t b_us = (uint64_t)b.bits * 1000000 / clock_hz;
+    printf("%-15s %8u %8u %+8ld  at %u Hz\n", "bus time (us)", a_us, b_us, (long)b_us - (long)a_us, clock_hz);
+    return 0;
+}
+
+static const char *out_path = NULL;
+
+/**
+ * Prints how the replay went and saves the replayed trace without the
+ * unmatched transactions at its end
+ */
+static void report(ToolReplayBus *bus){
+    printf("matched %u, skipped %u, extra %u, remaining %u\n", bus->matched(), bus->skipped(), bus->extra(),
+           bus->remaining());
+    if(bus->out != NULL){
+        std::vector<uint8_t> &data = bus->out->data;
+        if(bus->unmatched > 0){
+            printf("dropped %u unmatched transactions from the end of %s\n", bus->unmatched, out_path);
+            data.resize(bus->out_matched);
+        }
+        FILE *out = fopen(out_path, "wb");
+        if(out == NULL || fwrite(data.data(), 1, data.size(), out) != data.size())
+          perror(out_path);
+        if(out != NULL)
+          fclose(out);
+    }
+    fflush(stdout);
+}
+
+static void run_si1145(SiBus *bus){
+    SI114X si1145(bus);
+    if(!si1145.Begin())
+      return;
+    while(true){
+        si1145.ReadVisible();
+        si1145.ReadIR();
+        si1145.ReadUV();
+    }
+}
+
+static void run_si1151(SiBus *bus){
+    Si115X si1151(Si115X::DEVICE_ADDRESS, bus);
+    if(!si1151.Begin())
+      return;
+    while(true){
+        si1151.ReadIR();
+        si1151.ReadVisible();
+    }
+}
+
+static int replay(const char *chip, const char *path){
+    void (*run)(SiBus *) = NULL;
+    if(strcmp(chip, "si1145") == 0)
+      run = run_si1145;
+    else if(strcmp(chip, "si1151") == 0)
+      run = run_si1151;
+    else {
+        fprintf(stderr, "unknown chip %s\n", chip);
+        return 1;
+    }
+
+    std::vector<uint8_t> trace = load(path);
+    ToolReplayBus bus(trace.data(), trace.size());
+    bus.report = report;
+
+    BufferPrint out;
+    SiTraceRecorder recorder(&out);
+    if(out_path != NULL){
+        recorder.begin();
+        bus.set_trace(&recorder);
+        bus.out = &out;
+    }
+
+    run(&bus);
+    report(&bus);
+    return 0;
+}
+
+int main(int argc, char **argv){
+    if(argc == 3 && strcmp(argv[1], "dump") == 0)
+      return dump(argv[2]);
+    if(argc >= 4 && strcmp(argv[1], "diff") == 0){
+        bool model_only = strcmp(argv[2], "--model-only") == 0;
+        int first = model_only ? 3 : 2;
+        if(argc == first + 2 || argc == first + 3){
+            uint32_t clock_hz = argc == first + 3 ? strtoul(argv[first + 2], NULL, 0) : 100000;
+            if(clock_hz == 0){
+                fprintf(stderr, "bad clock %s\n", argv[first + 2]);
+                return 1;
+            }
+            return diff(argv[first], argv[first + 1], clock_hz, model_only);
+        }
+    }
+    if((argc == 4 || argc == 5) && strcmp(argv[1], "replay") == 0){
+        out_path = argc == 5 ? argv[4] : NULL;
+        return replay(argv[2], argv[3]);
+    }
+
+    fprintf(stderr, "usage: %s dump TRACE\n"
+                    "       %s diff [--model-only] OLD NEW [CLOCK_HZ]\n"
+                    "       %s replay si1145|si1151 TRACE [OUT]\n", argv[0], argv[0], argv[0]);
+    return 1;
+}